@@ -10,11 +10,16 @@
 
 # include <vector>
 # include <list>
+# include <iterator>
 # include <string>
+# include <string_view>
+# include <charconv>
 # include <queue>
 # include <stack>
 # include <map>
 # include <unordered_map>
+# include <unordered_set>
+# include <tuple>
 # include <ctime>
 # include <chrono>
 # include <iostream>
@@ -23,6 +28,33 @@
 # include <algorithm>
 # include <iomanip>
 # include <cmath>
+# include <array>
+# include <cstdint>
+# include <cstring>
+# include <cstdlib>
+# include <functional>
+# include <memory>
+# include <new>
+# include <type_traits>
+# include <utility>
+# include <mutex>
+# include <atomic>
+# include <thread>
+# include <condition_variable>
+
+# if defined(__AVX2__) || defined(__SSE2__)
+# include <immintrin.h>
+# endif
+
+# ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# endif
 
 using std::cin;
 using std::cout;
@@ -39,29 +71,39 @@ using std::priority_queue;
 // 
 //  A routine to count the time cost by a program in milliseconds.
 //  Using std::chrono library and std::chrono::steady_clock as clock epoch.
+//  Time points are kept in steady_clock ticks (nanoseconds), and only converted when reported.
 //
 //      pTime() to create a new counter.
 //      start():  Start counting.
 //      addPoint():  Add check points at this moment.
 //      end():   Stop counting.
 //      duration():  Return the length of total duration in ms.
+//      durationNs():  Return the length of total duration in ns.
 //      display():   Quickly display the counting result.
 //
 class pTime{
     // alias
-    using time_point_t = std::chrono::time_point<std::chrono::steady_clock, std::chrono::milliseconds>;
+    using time_point_t = std::chrono::steady_clock::time_point;
 private:
     // Member variables
     time_point_t startTime; // Start of counting
     time_point_t endTime;   // End of counting
     vector<time_point_t> points;    // Checkpoints during counting
     bool counting = false;  // Whether pTime is still running
+
+    // Convert a time point to nanoseconds or milliseconds since startTime
+    int64_t sinceStartNs(time_point_t t) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - startTime).count();
+    }
+    int64_t sinceStartMs(time_point_t t) const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(t - startTime).count();
+    }
 public:
     // Start couting
     void start(){
         points.clear();
         counting = true;
-        startTime = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now());
+        startTime = std::chrono::steady_clock::now();
         return;
     }
     // Add check points during counting
@@ -70,12 +112,12 @@ public:
             std::cerr << "Invalid check point." << endl;
             return;
         }
-        points.push_back(std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()));
+        points.push_back(std::chrono::steady_clock::now());
         return;
     }
     // End counting
     void end(){
-        points.push_back(std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()));
+        points.push_back(std::chrono::steady_clock::now());
         counting = false;
         endTime = points.back();
         return;
@@ -86,19 +128,33 @@ public:
             cerr << "pTime is still counting !" << endl;
             return 0;
         }
-        return (endTime - startTime).count();
+        return sinceStartMs(endTime);
+    }
+    // Return duration between startTime and end in nanosecond.
+    int64_t durationNs() const {
+        if ( counting == true ){
+            cerr << "pTime is still counting !" << endl;
+            return 0;
+        }
+        return sinceStartNs(endTime);
     }
     // Display counting information
+    // Shown in ms with three decimals, so sub-millisecond durations are not reported as 0.
     void display() const {
         if ( counting == true ){
             cerr << "pTime is still counting !" << endl;
             return;
         }
+        auto flags = cout.flags();
+        auto precision = cout.precision();
+        cout << std::fixed << std::setprecision(3);
         // Display checkpoints
         for (auto i = 0; i < points.size(); ++i)
-            cout << "# " << i+1 << "    " << (points[i]-startTime).count() << " ms" << endl;
+            cout << "# " << i+1 << "    " << sinceStartNs(points[i]) / 1e6 << " ms" << endl;
         // Display total time
-        cout << endl << "Running time:     " << (endTime - startTime).count() << " ms" << endl;
+        cout << endl << "Running time:     " << sinceStartNs(endTime) / 1e6 << " ms" << endl;
+        cout.flags(flags);
+        cout.precision(precision);
         return;
     }
     // Return a list of checkpoints and end point
@@ -109,11 +165,497 @@ public:
         }
         vector<int64_t> list;
         for (auto i : points)
-            list.push_back((i-startTime).count());
+            list.push_back(sinceStartMs(i));
+        return list;
+    }
+    // Return a list of checkpoints and end point in nanosecond
+    vector<int64_t> listNs() const {
+        if (counting == true){
+            cerr << "pTime is still counting !" << endl;
+            return {};
+        }
+        vector<int64_t> list;
+        for (auto i : points)
+            list.push_back(sinceStartNs(i));
         return list;
     }
 };
 
+
+//
+// -------------------- pProfiler --------------------
+//
+//  A scope based profiler with nanosecond resolution, built on the same steady_clock as pTime.
+//   1. pScope is a RAII object. It records the time between its construction and destruction.
+//   2. Scopes can be nested. Every thread records into its own call tree, so no lock is taken on the hot path.
+//   3. checkpoint() records a named time point of the current thread.
+//   4. report() merges all threads and prints call count, total and min/mean/max time of every scope.
+//      mode = "Table" : aligned table, nested scopes are indented.
+//      mode = "JSON"  : one JSON object, for scripts.
+//   5. report() and reset() should be called when profiled threads are quiescent.
+//   6. Define MYDSA_PROFILE before including myDSA.h to turn on PTIME_SCOPE() in trees and graphs.
+//
+class pProfiler{
+public:
+    // Aggregated result of one scope path
+    struct record {
+        string name;
+        string path;
+        unsigned depth = 0;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t minNs = 0;
+        uint64_t maxNs = 0;
+        double meanNs() const {
+            return count == 0 ? 0 : totalNs * 1.0 / count;
+        }
+    };
+    // Named time point
+    struct checkpointRecord {
+        unsigned thread;
+        string name;
+        int64_t ns;     // since the profiler was created
+    };
+
+    // Call tree of one thread. Only touched by its owner thread while recording.
+    class threadLog {
+    public:
+        // Enter a child scope of the current scope
+        void enter(const char *name) {
+            for (auto c : nodes[current].children){
+                if (nodes[c].name == name || std::strcmp(nodes[c].name, name) == 0){
+                    current = c;
+                    return;
+                }
+            }
+            // push_back may move nodes, so take the parent by index afterwards
+            nodes.push_back(scopeNode{name, current});
+            nodes[current].children.push_back(nodes.size() - 1);
+            current = nodes.size() - 1;
+        }
+        // Leave current scope, ns is the time spent in it
+        void leave(uint64_t ns) {
+            scopeNode &n = nodes[current];
+            ++n.count;
+            n.totalNs += ns;
+            n.minNs = std::min(n.minNs, ns);
+            n.maxNs = std::max(n.maxNs, ns);
+            current = n.parent;
+        }
+        friend class pProfiler;
+    private:
+        struct scopeNode {
+            const char *name;
+            unsigned parent;
+            uint64_t count = 0;
+            uint64_t totalNs = 0;
+            uint64_t minNs = UINT64_MAX;
+            uint64_t maxNs = 0;
+            vector<unsigned> children;
+            scopeNode(const char *n, unsigned p): name(n), parent(p) {}
+        };
+        unsigned id = 0;
+        // nodes[0] is the root of the call tree, and never timed.
+        vector<scopeNode> nodes{scopeNode{"", 0}};
+        unsigned current = 0;
+        vector<std::pair<const char *, int64_t>> checkpoints;
+    };
+
+    // The only profiler
+    static pProfiler &instance() {
+        static pProfiler profiler;
+        return profiler;
+    }
+
+    // Call tree of the calling thread, registered at the first call.
+    threadLog &local() {
+        thread_local threadLog *log = nullptr;
+        if (log == nullptr){
+            std::lock_guard<std::mutex> guard(registryLock);
+            logs.emplace_back(new threadLog);
+            log = logs.back().get();
+            log->id = logs.size() - 1;
+        }
+        return *log;
+    }
+
+    // Record a named time point of the calling thread
+    void checkpoint(const char *name) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+        local().checkpoints.emplace_back(name, ns);
+    }
+
+    // Merge the call trees of all threads, parents come before children.
+    vector<record> collect() const {
+        std::lock_guard<std::mutex> guard(registryLock);
+        vector<mergedNode> merged{mergedNode{}};
+        for (auto &log : logs)
+            merge(*log, 0, merged, 0);
+        vector<record> result;
+        flatten(merged, 0, "", 0, result);
+        return result;
+    }
+    vector<checkpointRecord> checkpoints() const {
+        std::lock_guard<std::mutex> guard(registryLock);
+        vector<checkpointRecord> result;
+        for (auto &log : logs)
+            for (auto &item : log->checkpoints)
+                result.push_back(checkpointRecord{log->id, item.first, item.second});
+        std::sort(result.begin(), result.end(), [](const checkpointRecord &a, const checkpointRecord &b){
+            return a.ns < b.ns;
+        });
+        return result;
+    }
+
+    // Print the merged result
+    void report(std::ostream &os = std::cout, string mode = "Table") const {
+        auto records = collect();
+        auto points = checkpoints();
+        if (mode == "Table"){
+            os << std::left << std::setw(40) << "scope" << std::right
+               << std::setw(12) << "count" << std::setw(16) << "total(ns)"
+               << std::setw(14) << "min(ns)" << std::setw(14) << "mean(ns)" << std::setw(14) << "max(ns)" << endl;
+            for (auto &r : records){
+                os << std::left << std::setw(40) << (string(2*r.depth, ' ') + r.name) << std::right
+                   << std::setw(12) << r.count << std::setw(16) << r.totalNs
+                   << std::setw(14) << r.minNs << std::setw(14) << static_cast<uint64_t>(r.meanNs())
+                   << std::setw(14) << r.maxNs << endl;
+            }
+            for (auto &p : points)
+                os << "# thread " << p.thread << "    " << p.name << "    " << p.ns << " ns" << endl;
+        } else if (mode == "JSON"){
+            os << "{\"scopes\": [";
+            for (size_t i = 0; i < records.size(); ++i){
+                auto &r = records[i];
+                os << (i == 0 ? "" : ", ") << "{\"name\": \"" << jsonEscape(r.name)
+                   << "\", \"path\": \"" << jsonEscape(r.path) << "\", \"depth\": " << r.depth
+                   << ", \"count\": " << r.count << ", \"total_ns\": " << r.totalNs
+                   << ", \"min_ns\": " << r.minNs << ", \"mean_ns\": " << r.meanNs()
+                   << ", \"max_ns\": " << r.maxNs << "}";
+            }
+            os << "], \"checkpoints\": [";
+            for (size_t i = 0; i < points.size(); ++i){
+                os << (i == 0 ? "" : ", ") << "{\"thread\": " << points[i].thread
+                   << ", \"name\": \"" << jsonEscape(points[i].name) << "\", \"ns\": " << points[i].ns << "}";
+            }
+            os << "]}" << endl;
+        } else {
+            cerr << "Error: unknown report mode " << mode << "." << endl;
+        }
+    }
+
+    // Clear all statistics but keep the registered threads
+    void reset() {
+        std::lock_guard<std::mutex> guard(registryLock);
+        for (auto &log : logs){
+            for (auto &n : log->nodes){
+                n.count = n.totalNs = n.maxNs = 0;
+                n.minNs = UINT64_MAX;
+            }
+            log->checkpoints.clear();
+        }
+        origin = std::chrono::steady_clock::now();
+    }
+
+private:
+    pProfiler(): origin(std::chrono::steady_clock::now()) {}
+
+    struct mergedNode {
+        string name;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t minNs = UINT64_MAX;
+        uint64_t maxNs = 0;
+        vector<unsigned> children;
+    };
+
+    // Merge the subtree of log under from into the merged tree under to.
+    static void merge(const threadLog &log, unsigned from, vector<mergedNode> &merged, unsigned to) {
+        for (auto c : log.nodes[from].children){
+            auto &src = log.nodes[c];
+            unsigned target = merged.size();
+            for (auto m : merged[to].children){
+                if (merged[m].name == src.name){
+                    target = m;
+                    break;
+                }
+            }
+            if (target == merged.size()){
+                merged.emplace_back();
+                merged.back().name = src.name;
+                merged[to].children.push_back(target);
+            }
+            merged[target].count += src.count;
+            merged[target].totalNs += src.totalNs;
+            merged[target].minNs = std::min(merged[target].minNs, src.minNs);
+            merged[target].maxNs = std::max(merged[target].maxNs, src.maxNs);
+            merge(log, c, merged, target);
+        }
+    }
+    // Pre-order walk of the merged tree
+    static void flatten(const vector<mergedNode> &merged, unsigned index, const string &path, unsigned depth, vector<record> &result) {
+        for (auto c : merged[index].children){
+            auto &n = merged[c];
+            record r;
+            r.name = n.name;
+            r.path = path.empty() ? n.name : path + "/" + n.name;
+            r.depth = depth;
+            r.count = n.count;
+            r.totalNs = n.totalNs;
+            r.minNs = n.count == 0 ? 0 : n.minNs;
+            r.maxNs = n.maxNs;
+            result.push_back(r);
+            flatten(merged, c, r.path, depth + 1, result);
+        }
+    }
+    static string jsonEscape(const string &s) {
+        string result;
+        for (auto c : s){
+            if (c == '"' || c == '\\') result.push_back('\\');
+            result.push_back(c);
+        }
+        return result;
+    }
+
+    mutable std::mutex registryLock;
+    // Logs are never erased, so the thread_local pointers stay valid after reset().
+    vector<std::unique_ptr<threadLog>> logs;
+    std::chrono::steady_clock::time_point origin;
+};
+
+//
+//  RAII scope of pProfiler:
+//   Enter the scope at construction and record the elapsed nanoseconds at destruction.
+//
+class pScope{
+public:
+    explicit pScope(const char *name):
+        log(pProfiler::instance().local()) {
+        log.enter(name);
+        begin = std::chrono::steady_clock::now();
+    }
+    ~pScope(){
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        log.leave(ns);
+    }
+    pScope(const pScope &) = delete;
+    pScope &operator=(const pScope &) = delete;
+private:
+    pProfiler::threadLog &log;
+    std::chrono::steady_clock::time_point begin;
+};
+
+// Instrumentation macro, compiled out unless MYDSA_PROFILE is defined.
+# define PTIME_CONCAT_IMPL(a, b) a##b
+# define PTIME_CONCAT(a, b) PTIME_CONCAT_IMPL(a, b)
+# ifdef MYDSA_PROFILE
+#   define PTIME_SCOPE(name) pScope PTIME_CONCAT(pScope_, __LINE__)(name)
+# else
+#   define PTIME_SCOPE(name)
+# endif
+
+//
+// -------------------- pStats --------------------
+//
+//  Summary statistics of a group of samples (e.g. nanoseconds of repeated runs).
+//  Percentiles use linear interpolation between the closest ranks.
+//
+struct pStats{
+    size_t count = 0;
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double stddev = 0;
+    double median = 0;
+    double p95 = 0;
+    double p99 = 0;
+
+    // Percentile q (0 ~ 1) of sorted samples
+    static double percentile(const vector<double> &sorted, double q) {
+        if (sorted.empty()) return 0;
+        double pos = q * (sorted.size() - 1);
+        size_t lower = static_cast<size_t>(pos);
+        if (lower + 1 >= sorted.size()) return sorted.back();
+        return sorted[lower] + (pos - lower) * (sorted[lower+1] - sorted[lower]);
+    }
+    // Compute statistics of samples, samples are taken by value and sorted here.
+    static pStats of(vector<double> samples) {
+        pStats st;
+        if (samples.empty()) return st;
+        std::sort(samples.begin(), samples.end());
+        st.count = samples.size();
+        st.min = samples.front();
+        st.max = samples.back();
+        double sum = 0;
+        for (auto x : samples) sum += x;
+        st.mean = sum / st.count;
+        double sq = 0;
+        for (auto x : samples) sq += (x - st.mean) * (x - st.mean);
+        st.stddev = st.count > 1 ? std::sqrt(sq / (st.count - 1)) : 0;
+        st.median = percentile(samples, 0.5);
+        st.p95 = percentile(samples, 0.95);
+        st.p99 = percentile(samples, 0.99);
+        return st;
+    }
+};
+
+//
+// -------------------- pCounters --------------------
+//
+//  Hardware performance counters of the calling thread, using Linux perf_event_open.
+//   1. Events: cycles, instructions, L1 data cache read misses, last level cache misses,
+//      branch misses and dTLB read misses. Only user space is counted.
+//   2. Counters are opened as one group when the kernel allows it, otherwise one by one.
+//      An event that cannot be opened is unavailable, and the others still work.
+//   3. On other platforms, without a PMU (e.g. some virtual machines) or when perf_event_paranoid forbids it,
+//      available() is false and every value is -1. Nothing else changes.
+//   4. Multiplexed counters are scaled by time enabled / time running.
+//   5. Used like pTime:  start(), stop(), value(), ipc(), display().
+//
+class pCounters{
+public:
+    enum event {CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, DTLB_MISSES, EVENT_NUM};
+    // Values of all events, -1 for unavailable ones
+    using sample = std::array<int64_t, EVENT_NUM>;
+
+    pCounters() {
+        fds.fill(-1);
+        result.fill(-1);
+# ifdef __linux__
+        int leader = -1;
+        for (int e = 0; e < EVENT_NUM; ++e){
+            fds[e] = open(static_cast<event>(e), leader);
+            // Some PMUs cannot put all events in one group, open it alone then.
+            if (fds[e] < 0 && leader >= 0)
+                fds[e] = open(static_cast<event>(e), -1);
+            if (leader < 0 && fds[e] >= 0)
+                leader = fds[e];
+        }
+# endif
+    }
+    ~pCounters() {
+# ifdef __linux__
+        for (auto fd : fds)
+            if (fd >= 0) close(fd);
+# endif
+    }
+    pCounters(const pCounters &) = delete;
+    pCounters &operator=(const pCounters &) = delete;
+
+    // Whether any counter or a given counter can be read
+    bool available() const {
+        for (auto fd : fds)
+            if (fd >= 0) return true;
+        return false;
+    }
+    bool available(event e) const {
+        return fds[e] >= 0;
+    }
+
+    // Reset and start counting
+    void start() {
+# ifdef __linux__
+        for (auto fd : fds){
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+# endif
+    }
+    // Stop counting and read values
+    void stop() {
+        result.fill(-1);
+# ifdef __linux__
+        for (auto fd : fds)
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        for (int e = 0; e < EVENT_NUM; ++e){
+            if (fds[e] < 0) continue;
+            // value, time enabled, time running
+            uint64_t data[3] = {0, 0, 0};
+            if (read(fds[e], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+            result[e] = static_cast<int64_t>(data[0] * (data[1] * 1.0 / data[2]));
+        }
+# endif
+    }
+
+    int64_t value(event e) const {
+        return result[e];
+    }
+    const sample &values() const {
+        return result;
+    }
+    // Instructions per cycle, -1 if unavailable
+    static double ipc(const sample &v) {
+        if (v[CYCLES] <= 0 || v[INSTRUCTIONS] < 0) return -1;
+        return v[INSTRUCTIONS] * 1.0 / v[CYCLES];
+    }
+    double ipc() const {
+        return ipc(result);
+    }
+    static const char *name(event e) {
+        static const char *names[EVENT_NUM] = {"cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "dTLB-misses"};
+        return names[e];
+    }
+    // Display counting information, divided by n (e.g. number of elements) if given.
+    void display(std::ostream &os = std::cout, double n = 1) const {
+        for (int e = 0; e < EVENT_NUM; ++e){
+            os << std::left << std::setw(16) << name(static_cast<event>(e)) << std::right;
+            if (result[e] < 0) os << std::setw(16) << "n/a" << endl;
+            else os << std::setw(16) << result[e] / n << endl;
+        }
+        os << std::left << std::setw(16) << "IPC" << std::right << std::setw(16) << ipc() << endl;
+    }
+
+private:
+    std::array<int, EVENT_NUM> fds;
+    sample result;
+
+# ifdef __linux__
+    // Open one counter of the calling thread, return -1 on failure.
+    static int open(event e, int groupFd) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        auto cacheMiss = [](uint64_t cache){
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        switch (e){
+        case CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+        default:
+            return -1;
+        }
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+# endif
+};
+
 //
 // -------------------- Fundamental --------------------
 //
@@ -213,15 +755,124 @@ void myHist(vector<X> xs, vector<Y> ys, unsigned height = 20, unsigned gap = 8)
 }
 
 
+//
+// Allocation accounting:
+//  1. myAllocStats counts allocations, frees, live bytes and peak bytes of one container instance.
+//  2. Opt-in: numbers are only counted when MYDSA_ALLOC_STATS is defined before including myDSA.h.
+//     Otherwise onAlloc() and onFree() are empty and compiled away.
+//  3. myCountingAllocator is a std allocator reporting to a myAllocStats, for std containers inside my containers.
+//     Without MYDSA_ALLOC_STATS it is an empty class, just like std::allocator.
+//
+struct myAllocStats {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t liveBytes = 0;
+    uint64_t peakBytes = 0;
+
+    void onAlloc([[maybe_unused]] size_t bytes) {
+# ifdef MYDSA_ALLOC_STATS
+        ++allocations;
+        liveBytes += bytes;
+        peakBytes = std::max(peakBytes, liveBytes);
+# endif
+    }
+    void onFree([[maybe_unused]] size_t bytes) {
+# ifdef MYDSA_ALLOC_STATS
+        ++frees;
+        liveBytes -= bytes;
+# endif
+    }
+    // Live allocations, for node based containers it equals the number of nodes.
+    uint64_t liveBlocks() const {
+        return allocations - frees;
+    }
+    double bytesPerElement(size_t elements) const {
+        return elements == 0 ? 0 : liveBytes * 1.0 / elements;
+    }
+    void print(std::ostream &os = std::cout) const {
+        os << "allocations: " << allocations << ",  frees: " << frees
+           << ",  live bytes: " << liveBytes << ",  peak bytes: " << peakBytes << endl;
+    }
+};
+
+template <typename T>
+class myCountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    myCountingAllocator() = default;
+    explicit myCountingAllocator([[maybe_unused]] myAllocStats *s) {
+# ifdef MYDSA_ALLOC_STATS
+        stats = s;
+# endif
+    }
+    // Rebind constructor, std::list allocates its nodes through a rebound allocator.
+    template <typename U>
+    myCountingAllocator([[maybe_unused]] const myCountingAllocator<U> &rhs) {
+# ifdef MYDSA_ALLOC_STATS
+        stats = rhs.stats;
+# endif
+    }
+
+    T *allocate(size_t n) {
+# ifdef MYDSA_ALLOC_STATS
+        if (stats != nullptr) stats->onAlloc(n * sizeof(T));
+# endif
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *ptr, [[maybe_unused]] size_t n) {
+# ifdef MYDSA_ALLOC_STATS
+        if (stats != nullptr) stats->onFree(n * sizeof(T));
+# endif
+        ::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const myCountingAllocator<U> &rhs) const {
+# ifdef MYDSA_ALLOC_STATS
+        return stats == rhs.stats;
+# else
+        return true;
+# endif
+    }
+    template <typename U>
+    bool operator!=(const myCountingAllocator<U> &rhs) const {
+        return !(*this == rhs);
+    }
+
+    template <typename U> friend class myCountingAllocator;
+private:
+# ifdef MYDSA_ALLOC_STATS
+    myAllocStats *stats = nullptr;
+# endif
+};
+
+// Whether a container provides allocStats(), used by benchmarks.
+template <typename C, typename = void>
+struct hasAllocStats : std::false_type {};
+template <typename C>
+struct hasAllocStats<C, decltype(void(std::declval<const C &>().allocStats()))> : std::true_type {};
+// Whether a container provides size(), used by benchmarks.
+template <typename C, typename = void>
+struct hasSize : std::false_type {};
+template <typename C>
+struct hasSize<C, decltype(void(std::declval<const C &>().size()))> : std::true_type {};
+
+
 //
 // -------------------- Linear List --------------------
 //
 
 //
 //  Linked list implementation:
-//   1. Just one direction. And for briefness, I do not encapsulate node, and it is visible to users.
-//   2. In fact, I could make it more professional if I encapsulate node and create an iterator class for node reference.
-//   3. But that would cost heavier works. Maybe in the future!
+//   1. Doubly linked, with two sentinel nodes. So insert, remove and splice are all O(1).
+//   2. node is still visible to users. Besides, iterator and const_iterator give STL style access,
+//      and they can be used with std algorithms.
+//   3. Positions passed in (node pointer or iterator) must belong to this list, it is not checked by walking the list.
+//   4. See myIntrusiveList for the intrusive mode, in which elements embed the links and no node is allocated.
 //
 
 template <typename T>
@@ -230,6 +881,9 @@ public:
     // Internal node structure.
     class node {
     public:
+        node() = default;
+        explicit node(const T &val): value(val) {}
+        explicit node(T &&val): value(std::move(val)) {}
         T getValue() const {
             return value;
         }
@@ -241,34 +895,127 @@ public:
         const node *getNext() const {
             return next;
         }
+        const node *getPrev() const {
+            return prev;
+        }
         // Even node is put inside myList, 
         // if myList want to use the private members, node should still possess a friend claim.
         friend class myList<T>;
     private:
-        T value = 0;
+        T value{};
+        node *prev = nullptr;
         node *next = nullptr;
     };
 
+    // Bidirectional iterator, Const decides whether it is a const_iterator.
+    template <bool Const>
+    class basicIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<Const, const T *, T *>::type;
+        using reference = typename std::conditional<Const, const T &, T &>::type;
+
+        basicIterator() = default;
+        // iterator can be converted to const_iterator
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        basicIterator(const basicIterator<false> &rhs): ptr(rhs.ptr) {}
+
+        reference operator*() const {
+            return ptr->value;
+        }
+        pointer operator->() const {
+            return &ptr->value;
+        }
+        basicIterator &operator++() {
+            ptr = ptr->next;
+            return *this;
+        }
+        basicIterator operator++(int) {
+            basicIterator old = *this;
+            ptr = ptr->next;
+            return old;
+        }
+        basicIterator &operator--() {
+            ptr = ptr->prev;
+            return *this;
+        }
+        basicIterator operator--(int) {
+            basicIterator old = *this;
+            ptr = ptr->prev;
+            return old;
+        }
+        bool operator==(const basicIterator &rhs) const {
+            return ptr == rhs.ptr;
+        }
+        bool operator!=(const basicIterator &rhs) const {
+            return ptr != rhs.ptr;
+        }
+        // The node this iterator points to
+        node *getNode() const {
+            return ptr;
+        }
+        friend class myList<T>;
+    private:
+        explicit basicIterator(node *p): ptr(p) {}
+        node *ptr = nullptr;
+    };
+    using iterator = basicIterator<false>;
+    using const_iterator = basicIterator<true>;
+
     // Constructor and destructor
     myList () {
         head = new node;
         tail = new node;
-        head -> next = tail;
+        stats.onAlloc(2 * sizeof(node));
+        head->next = tail;
+        tail->prev = head;
         listSize = 0;
     }
+    // Copy constructor and copy assignment, copy every value.
+    myList (const myList &rhs): myList() {
+        for (auto &val : rhs)
+            push_back(val);
+    }
+    myList &operator=(const myList &rhs) {
+        if (this == &rhs) return *this;
+        clear();
+        for (auto &val : rhs)
+            push_back(val);
+        return *this;
+    }
     // Destructor
     ~myList () {
         clear();
         delete head;
         delete tail;
+        stats.onFree(2 * sizeof(node));
     }
 
-    // Attention: Lack of copy function, default only shallow copy
-
     // Get the size
     unsigned size() const {
         return listSize;
     }
+    // Allocation statistics. Nodes created by users are counted when the list takes them over.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
+
+    // Iterators
+    iterator begin() {
+        return iterator(head->next);
+    }
+    iterator end() {
+        return iterator(tail);
+    }
+    const_iterator begin() const {
+        return const_iterator(head->next);
+    }
+    const_iterator end() const {
+        return const_iterator(tail);
+    }
+
     // push and pop
     void push_back(node *ptr){
         insert(tail, ptr);
@@ -276,25 +1023,56 @@ public:
     void push_front(node *ptr){
         insert(head->next, ptr);
     }
+    void push_back(const T &val){
+        insert(end(), val);
+    }
+    void push_back(T &&val){
+        insert(end(), std::move(val));
+    }
+    void push_front(const T &val){
+        insert(begin(), val);
+    }
+    void push_front(T &&val){
+        insert(begin(), std::move(val));
+    }
     void pop_back(){
         remove(back());
     }
     void pop_front(){
         remove(head->next);
     }
-    // Insert ptr at the position in front of pos
-    void insert(node *pos, node *ptr){
-        node *last = head;
-        while (last->next != pos){
-            if (last == tail) {
-                cerr << "Insert error: inserting position is not in this list." << endl;
-                return;
-            }
-            last = last->next;
+    // Insert ptr at the position in front of pos, return false if pos or ptr is invalid
+    bool insert(node *pos, node *ptr){
+        if (!validPosition(pos) || ptr == nullptr) {
+            cerr << "Insert error: invalid inserting position or node." << endl;
+            return false;
         }
-        last->next = ptr;
+        ptr->prev = pos->prev;
         ptr->next = pos;
+        pos->prev->next = ptr;
+        pos->prev = ptr;
         ++listSize;
+        stats.onAlloc(sizeof(node));
+        return true;
+    }
+    // Insert a new value in front of pos, return iterator of the new value (end() if pos is invalid)
+    iterator insert(iterator pos, const T &val){
+        if (!validPosition(pos.ptr)){
+            cerr << "Insert error: invalid inserting position or node." << endl;
+            return end();
+        }
+        node *ptr = new node(val);
+        insert(pos.ptr, ptr);
+        return iterator(ptr);
+    }
+    iterator insert(iterator pos, T &&val){
+        if (!validPosition(pos.ptr)){
+            cerr << "Insert error: invalid inserting position or node." << endl;
+            return end();
+        }
+        node *ptr = new node(std::move(val));
+        insert(pos.ptr, ptr);
+        return iterator(ptr);
     }
     // Remove node
     void remove(node *ptr){
@@ -302,28 +1080,58 @@ public:
             cerr << "Empty list cannot apply remove()." << endl;
             return;
         }
-        node *last = head;
-        while (last->next != ptr){
-            if (last == tail){
-                cerr << "Remove error: node is not in this list." << endl;
-                return;
-            }
-            last = last->next;
+        if (ptr == nullptr || ptr == head || ptr == tail){
+            cerr << "Remove error: node is not in this list." << endl;
+            return;
         }
-        last->next = ptr->next;
+        unlink(ptr);
         delete ptr;
         --listSize;
+        stats.onFree(sizeof(node));
+    }
+    // Remove the value at pos, return iterator of the next value
+    iterator erase(iterator pos){
+        node *next = pos.ptr->next;
+        remove(pos.ptr);
+        return iterator(next);
+    }
+
+    // Move the node at it from other (can be this list) to the position in front of pos. No node is copied.
+    // Within one list nothing is counted, between lists the node is handed over from other's stats to this one's.
+    void splice(iterator pos, myList &other, iterator it){
+        node *ptr = it.ptr;
+        if (ptr == pos.ptr || ptr->next == pos.ptr) return;
+        other.unlink(ptr);
+        link(pos.ptr, ptr);
+        if (&other == this) return;
+        --other.listSize;
+        other.stats.onFree(sizeof(node));
+        ++listSize;
+        stats.onAlloc(sizeof(node));
+    }
+    // Move all nodes of other in front of pos.
+    void splice(iterator pos, myList &other){
+        if (&other == this || other.empty()) return;
+        node *first = other.head->next, *last = other.tail->prev;
+        other.head->next = other.tail;
+        other.tail->prev = other.head;
+        first->prev = pos.ptr->prev;
+        last->next = pos.ptr;
+        pos.ptr->prev->next = first;
+        pos.ptr->prev = last;
+        listSize += other.listSize;
+        stats.onAlloc(other.listSize * sizeof(node));
+        other.stats.onFree(other.listSize * sizeof(node));
+        other.listSize = 0;
     }
+
     // Front and back, editable
     node *back(){
         if (empty()){
             cerr << "Error： cannot apply back() on empty list." << endl;
             return {};
         }
-        node *ptr = head;
-        while (ptr->next != tail)
-            ptr = ptr->next;
-        return ptr;
+        return tail->prev;
     }
     node *front(){
         if (empty()){
@@ -338,10 +1146,7 @@ public:
             cerr << "Error： cannot apply back() on empty list." << endl;
             return {};
         }
-        node *ptr = head;
-        while (ptr->next != tail)
-            ptr = ptr->next;
-        return ptr;
+        return tail->prev;
     }
     const node *front() const {
         if (empty()){
@@ -359,506 +1164,879 @@ public:
     }
     // Print the list to output
     void print(std::ostream &output) const {
-        auto ptr = head->next;
         output << "[";
-        while (ptr != tail && ptr->next != tail){
-            output << ptr->value << ", ";
-            ptr = ptr->next;
-        }
-        output << ptr->value << "]" << endl;
+        for (node *ptr = head->next; ptr != tail; ptr = ptr->next)
+            output << ptr->value << (ptr->next == tail ? "" : ", ");
+        output << "]" << endl;
     }
 private:
     // Two sentinel nodes at the begin and end of the list
     node *head;
     node *tail;
     unsigned listSize;
+    myAllocStats stats;
+
+    // A value can be inserted in front of any node but the head sentinel
+    bool validPosition(const node *pos) const {
+        return pos != nullptr && pos != head && pos->prev != nullptr;
+    }
+    // Link ptr in front of pos, and unlink ptr from its neighbours. Size is not changed.
+    void link(node *pos, node *ptr){
+        ptr->prev = pos->prev;
+        ptr->next = pos;
+        pos->prev->next = ptr;
+        pos->prev = ptr;
+    }
+    void unlink(node *ptr){
+        ptr->prev->next = ptr->next;
+        ptr->next->prev = ptr->prev;
+    }
 };
 
 
 //
-//  Stack implementation:
-//  Use std::vector, and it is pretty easy.
+//  Intrusive linked list:
+//   1. Elements derive from myListHook<Tag> and carry the links themselves, so the list never allocates.
+//      Use different Tag types if an element should be in several lists at the same time.
+//   2. The list does not own elements. An element must stay alive while it is linked, and it is only unlinked on clear().
+//   3. The same O(1) insert, erase and splice as myList, and a circular sentinel hook.
 //
+template <typename Tag = void>
+struct myListHook {
+    myListHook *prev = nullptr;
+    myListHook *next = nullptr;
+    bool linked() const {
+        return next != nullptr;
+    }
+};
 
-template <typename T>
-class myStack{
+template <typename T, typename Tag = void>
+class myIntrusiveList {
+    using hook = myListHook<Tag>;
 public:
-    T top() const {
-        if (empty()){
-            cerr << "Error: cannot get the top element of empty stack." << endl;
-            return {};
+    template <bool Const>
+    class basicIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<Const, const T *, T *>::type;
+        using reference = typename std::conditional<Const, const T &, T &>::type;
+
+        basicIterator() = default;
+        explicit basicIterator(hook *h): ptr(h) {}
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        basicIterator(const basicIterator<false> &rhs): ptr(rhs.ptr) {}
+
+        reference operator*() const {
+            return *static_cast<pointer>(ptr);
         }
-        return list.back();
-    }
-    void pop() {
-        if (empty()){
-            cerr << "Error: cannot apply pop() on empty stack." << endl;
-            return;
+        pointer operator->() const {
+            return static_cast<pointer>(ptr);
+        }
+        basicIterator &operator++() {
+            ptr = ptr->next;
+            return *this;
+        }
+        basicIterator operator++(int) {
+            basicIterator old = *this;
+            ptr = ptr->next;
+            return old;
+        }
+        basicIterator &operator--() {
+            ptr = ptr->prev;
+            return *this;
+        }
+        basicIterator operator--(int) {
+            basicIterator old = *this;
+            ptr = ptr->prev;
+            return old;
+        }
+        bool operator==(const basicIterator &rhs) const {
+            return ptr == rhs.ptr;
         }
-        list.pop_back();
+        bool operator!=(const basicIterator &rhs) const {
+            return ptr != rhs.ptr;
+        }
+        friend class myIntrusiveList;
+    private:
+        hook *ptr = nullptr;
+    };
+    using iterator = basicIterator<false>;
+    using const_iterator = basicIterator<true>;
+
+    myIntrusiveList() {
+        sentinel.prev = sentinel.next = &sentinel;
     }
-    // Left reference input
-    void push(const T &elem){
-        list.push_back(elem);
+    // Links live in the elements, so a copy would share them.
+    myIntrusiveList(const myIntrusiveList &) = delete;
+    myIntrusiveList &operator=(const myIntrusiveList &) = delete;
+    ~myIntrusiveList() {
+        clear();
     }
-    // Right reference input
-    void push(T &&elem){
-        list.push_back(std::move(elem));
+
+    unsigned size() const {
+        return listSize;
     }
     bool empty() const {
-        return list.empty();
+        return listSize == 0;
     }
-    void clear() {
-        list.clear();
+    iterator begin() {
+        return iterator(sentinel.next);
     }
-    unsigned size() const {
-        return list.size();
+    iterator end() {
+        return iterator(&sentinel);
+    }
+    const_iterator begin() const {
+        return const_iterator(sentinel.next);
+    }
+    const_iterator end() const {
+        return const_iterator(const_cast<hook *>(&sentinel));
+    }
+    // Iterator of an element in this list, O(1).
+    iterator iteratorTo(T &elem) {
+        return iterator(static_cast<hook *>(&elem));
     }
-private:
-    vector<T> list;
-};
-
 
-//
-//  Queue implementation:
-//  Use circular array
-// 
-template <typename T>
-class myQueue{
-public:
-    myQueue():
-        capacity(16), listSize(0), start(1), end(0){
-        list = new T[INITSIZE];
+    T &front() {
+        return *begin();
     }
-    ~myQueue(){
-        delete list;
+    T &back() {
+        return *iterator(sentinel.prev);
     }
-    void push(const T &elem){
-        if (listSize == capacity - 1)
-            resize();
-        // Circular
-        if (++end == capacity) end = 0;
-        list[end] = elem;
-        ++listSize;
+    void push_back(T &elem) {
+        insert(end(), elem);
     }
-    void push(T &&elem){
-        if (listSize == capacity - 1)
-            resize();
-        if (++end == capacity) end = 0;
-        list[end] = elem;
-        ++listSize;
+    void push_front(T &elem) {
+        insert(begin(), elem);
     }
-    void pop(){
+    void pop_back() {
         if (empty()){
-            cerr << "Error: cannot apply pop() on empty queue." << endl;
+            cerr << "Error: cannot apply pop_back() on empty list." << endl;
             return;
         }
-        if (++start == capacity) start = 0;
-        --listSize;
+        erase(iterator(sentinel.prev));
     }
-
-    // Change the array to new and larger one.
-    // That is make capacity larger.
-    void resize() {
-        T *newList = new T[2*capacity+1];
-        unsigned j = 0;
-        for (auto i = start; i != end; ++i){
-            if (i == capacity) i = 0;
-            newList[j++] = list[i];
-        }
-        newList[j] = list[end];
-        capacity = capacity*2 + 1;
-        delete list;
-        list = newList;
-        start = 1;
-        end = 0;
+    void pop_front() {
+        if (empty()){
+            cerr << "Error: cannot apply pop_front() on empty list." << endl;
+            return;
+        }
+        erase(begin());
+    }
+    // Link elem in front of pos
+    iterator insert(iterator pos, T &elem) {
+        hook *h = static_cast<hook *>(&elem);
+        if (h->linked()){
+            cerr << "Insert error: element is already linked." << endl;
+            return iterator(h);
+        }
+        link(pos.ptr, h);
+        ++listSize;
+        return iterator(h);
     }
-    T front() const {
-        return list[start];
+    // Unlink the element at pos, return iterator of the next element
+    iterator erase(iterator pos) {
+        hook *next = pos.ptr->next;
+        unlink(pos.ptr);
+        --listSize;
+        return iterator(next);
     }
-    T back() const {
-        return list[end];
+    void remove(T &elem) {
+        erase(iteratorTo(elem));
     }
-    bool empty() const {
-        return listSize == 0;
+    // Move the element at it from other (can be this list) in front of pos.
+    void splice(iterator pos, myIntrusiveList &other, iterator it) {
+        if (it.ptr == pos.ptr || it.ptr->next == pos.ptr) return;
+        other.unlink(it.ptr);
+        --other.listSize;
+        link(pos.ptr, it.ptr);
+        ++listSize;
     }
+    // Unlink all elements
     void clear() {
-        start = 1;
-        end = 0;
+        hook *h = sentinel.next;
+        while (h != &sentinel){
+            hook *next = h->next;
+            h->prev = h->next = nullptr;
+            h = next;
+        }
+        sentinel.prev = sentinel.next = &sentinel;
         listSize = 0;
     }
-    unsigned size() const {
-        return listSize;
-    }
-    
+
 private:
-    // Initial capacity of real array
-    const unsigned INITSIZE = 16;
-    T *list;
-    // Capacity is the real capacity of the array
-    unsigned capacity;
-    // listSize is the size of valid data
-    unsigned listSize;
-    // Start and end mark the start and end position of valid data
-    unsigned start;
-    unsigned end;
-};
+    hook sentinel;
+    unsigned listSize = 0;
 
+    void link(hook *pos, hook *h) {
+        h->prev = pos->prev;
+        h->next = pos;
+        pos->prev->next = h;
+        pos->prev = h;
+    }
+    void unlink(hook *h) {
+        h->prev->next = h->next;
+        h->next->prev = h->prev;
+        h->prev = h->next = nullptr;
+    }
+};
 
-//
-// -------------------- Tree --------------------
-//
 
 //
-// Binary tree node structure
+//  Unrolled linked list:
+//   1. Each node holds an array of about one cache line of elements (Bytes, at least 2 elements),
+//      so a scan walks arrays instead of chasing one pointer per element.
+//   2. A full node is split into two half nodes on insertion. After erasing, a node less than half full
+//      is merged with a neighbour if they fit in one node.
+//   3. Same value interface as myList, with STL style bidirectional iterators.
+//      Iterators are invalidated by insert() and erase(), use the returned iterator instead.
+//   4. T should be default constructible and move assignable.
 //
-template <typename T>
-struct myBinaryTreeNode {
-    T value;
-    myBinaryTreeNode *left = nullptr;
-    myBinaryTreeNode *right = nullptr;
-    // Constructor
-    myBinaryTreeNode(const T &val): value(val){}
-    myBinaryTreeNode(T &&val): value(std::move(val)){}
-};
+template <typename T, unsigned Bytes = 64>
+class myUnrolledList {
+public:
+    // Number of elements in one node
+    static constexpr unsigned CAPACITY = sizeof(T) * 2 > Bytes ? 2 : Bytes / sizeof(T);
 
-//
-//  Converter from infix to postfix expression
-//
-std::string infix2Postfix(const string &infix) {
-    std::vector<char> operatorList{'+','-','*','/','(',')', ' '};
-    std::map<char, unsigned> priority{
-        {'(', 100},
-        {'+', 1}, {'-', 1},
-        {'*', 2}, {'/', 2}
+private:
+    struct node {
+        alignas(64) T items[CAPACITY];
+        unsigned count = 0;
+        node *prev = nullptr;
+        node *next = nullptr;
     };
-    std::stack<char> s;
-    string postfix;
-    // Deal with prefix sign '+' and '-'
-    size_t i = 0;
-    string infixNew{infix};
-    while (i < infixNew.size() && infixNew[i] == ' ') ++i;
-    if (i >= infixNew.size()) return 0;
-    // Sign at the beginning of expression
-    if (infixNew[i] == '-' || infixNew[i] == '+')
-        infixNew.insert(i, 1,'0');
-    while (i < infixNew.size()-1){
-        // sign in the middle, '(-' and '(+'
-        if (infixNew[i] == '(' && (infixNew[i+1] == '-' || infixNew[i+1] == '+'))
-            infixNew.insert(i+1, 1,'0');
-        ++i;
-    }
-    // convert
-    for (auto c : infixNew){
-        if ( isdigit(c) || c == '.' ){
-            postfix.push_back(c);
-        } else {
-            postfix.push_back(' ');
-            if ( c == ' ' ) continue;
-            if ( c == ')' ){
-                while ( s.top() != '(' ){
-                    postfix.push_back(s.top());
-                    s.pop();
-                }
-                s.pop();
+
+public:
+    template <bool Const>
+    class basicIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<Const, const T *, T *>::type;
+        using reference = typename std::conditional<Const, const T &, T &>::type;
+
+        basicIterator() = default;
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        basicIterator(const basicIterator<false> &rhs): list(rhs.list), ptr(rhs.ptr), index(rhs.index) {}
+
+        reference operator*() const {
+            return ptr->items[index];
+        }
+        pointer operator->() const {
+            return &ptr->items[index];
+        }
+        basicIterator &operator++() {
+            if (++index == ptr->count){
+                ptr = ptr->next;
+                index = 0;
+            }
+            return *this;
+        }
+        basicIterator operator++(int) {
+            basicIterator old = *this;
+            ++*this;
+            return old;
+        }
+        // end() is (nullptr, 0), so decrement from it goes to the last node
+        basicIterator &operator--() {
+            if (ptr == nullptr){
+                ptr = list->last;
+                index = ptr->count - 1;
+            } else if (index == 0){
+                ptr = ptr->prev;
+                index = ptr->count - 1;
             } else {
-                while ( !s.empty() && s.top() != '(' && priority[s.top()] >= priority[c] ){
-                    postfix.push_back(s.top());
-                    s.pop();
-                }
-                s.push(c);
+                --index;
             }
+            return *this;
+        }
+        basicIterator operator--(int) {
+            basicIterator old = *this;
+            --*this;
+            return old;
         }
+        bool operator==(const basicIterator &rhs) const {
+            return ptr == rhs.ptr && index == rhs.index;
+        }
+        bool operator!=(const basicIterator &rhs) const {
+            return !(*this == rhs);
+        }
+        friend class myUnrolledList;
+    private:
+        basicIterator(const myUnrolledList *l, node *p, unsigned i): list(l), ptr(p), index(i) {}
+        const myUnrolledList *list = nullptr;
+        node *ptr = nullptr;
+        unsigned index = 0;
+    };
+    using iterator = basicIterator<false>;
+    using const_iterator = basicIterator<true>;
+
+    myUnrolledList() = default;
+    myUnrolledList(const myUnrolledList &rhs) {
+        for (auto &val : rhs)
+            push_back(val);
     }
-    while ( !s.empty() ){
-        postfix.push_back(s.top());
-        s.pop();
+    myUnrolledList &operator=(const myUnrolledList &rhs) {
+        if (this == &rhs) return *this;
+        clear();
+        for (auto &val : rhs)
+            push_back(val);
+        return *this;
+    }
+    ~myUnrolledList() {
+        clear();
     }
-    return postfix;
-}
 
+    unsigned size() const {
+        return listSize;
+    }
+    bool empty() const {
+        return listSize == 0;
+    }
+    // Allocation statistics, one live block per node.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
 
-//
-//  Expression Tree Implementation:
-//  1. Using myBinaryTreeNode template and use std::string to instantiate it
-//  2. In expression tree, leaf node contain operand strings and non-leaf node contain operators (in string).
-//  3. Expression public routines include three expression notation: prefix, infix, postfix
-//  4. By now, only support binary operators: +, -, *, /
-//
-class myExpressionTree{
-public:
-    // Destructor
-    ~myExpressionTree(){
-        clear();
+    iterator begin() {
+        return iterator(this, first, 0);
+    }
+    iterator end() {
+        return iterator(this, nullptr, 0);
+    }
+    const_iterator begin() const {
+        return const_iterator(this, first, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(this, nullptr, 0);
     }
 
-    // Using std::stack to create expression tree
-    void readPostfix(const std::string &postfix) {
-        std::stack<myBinaryTreeNode<string> *> s;
-        // operand : temperarily store operand strings
-        std::string operand;
-        for (auto c : postfix){
-            if (c == ' ' || c == '+' || c == '-' || c == '*' || c == '/'){
-                // push operand node to stack
-                if (!operand.empty()){
-                    myBinaryTreeNode<string> *leaf = new myBinaryTreeNode<string>(operand);
-                    s.push(leaf);
-                    operand.clear();
-                }
-                // push operator node to stack
-                if (c != ' '){
-                    myBinaryTreeNode<string> *node = new myBinaryTreeNode<string>(string() + c);
-                    auto right = s.top(); s.pop();
-                    auto left = s.top(); s.pop();
-                    node->left = left;
-                    node->right = right;
-                    s.push(node);
-                }
-            } else {
-                // record operand string
-                operand.push_back(c);
-            }
-        }
-        root = s.top(); s.pop();
-        if (!s.empty()){
-            cerr << "Error: Invalid postfix expression." << endl;
+    // Front and back, empty list is not allowed.
+    T &front() {
+        return first->items[0];
+    }
+    T &back() {
+        return last->items[last->count - 1];
+    }
+    const T &front() const {
+        return first->items[0];
+    }
+    const T &back() const {
+        return last->items[last->count - 1];
+    }
+
+    void push_back(const T &val) {
+        insert(end(), val);
+    }
+    void push_back(T &&val) {
+        insert(end(), std::move(val));
+    }
+    void push_front(const T &val) {
+        insert(begin(), val);
+    }
+    void push_front(T &&val) {
+        insert(begin(), std::move(val));
+    }
+    void pop_back() {
+        if (empty()){
+            cerr << "Error: cannot apply pop_back() on empty list." << endl;
             return;
         }
+        erase(iterator(this, last, last->count - 1));
     }
-    // Use infix2Postfix to convert infix to postfix, then read postfix
-    void readInfix(const std::string &infix) {
-        std::string postfix = infix2Postfix(infix);
-        readPostfix(postfix);
+    void pop_front() {
+        if (empty()){
+            cerr << "Error: cannot apply pop_front() on empty list." << endl;
+            return;
+        }
+        erase(begin());
     }
 
-    // Return three types of expression
-    void printInfix(std::ostream &output = std::cout) const {
-        printInfix(root, output);
+    // Insert val in front of pos, return iterator of the new value
+    iterator insert(iterator pos, const T &val) {
+        T copy = val;
+        return insert(pos, std::move(copy));
     }
-    void printPostfix(std::ostream &output = std::cout) const {
-        printPostfix(root, output);
+    iterator insert(iterator pos, T &&val) {
+        node *ptr = pos.ptr;
+        unsigned index = pos.index;
+        if (ptr == nullptr){
+            // Insert at end: append to the last node
+            if (last == nullptr || last->count == CAPACITY)
+                linkAfter(last, newNode());
+            ptr = last;
+            index = ptr->count;
+        } else if (ptr->count == CAPACITY){
+            // Full node: move the upper half into a new node after it
+            node *half = newNode();
+            linkAfter(ptr, half);
+            unsigned keep = CAPACITY / 2;
+            for (unsigned i = keep; i < CAPACITY; ++i)
+                half->items[i - keep] = std::move(ptr->items[i]);
+            half->count = CAPACITY - keep;
+            ptr->count = keep;
+            if (index > keep){
+                ptr = half;
+                index -= keep;
+            }
+        }
+        for (unsigned i = ptr->count; i > index; --i)
+            ptr->items[i] = std::move(ptr->items[i-1]);
+        ptr->items[index] = std::move(val);
+        ++ptr->count;
+        ++listSize;
+        return iterator(this, ptr, index);
     }
-    void printPrefix(std::ostream &output = std::cout) const {
-        printPrefix(root, output);
+
+    // Erase the value at pos, return iterator of the next value
+    iterator erase(iterator pos) {
+        node *ptr = pos.ptr;
+        unsigned index = pos.index;
+        for (unsigned i = index; i + 1 < ptr->count; ++i)
+            ptr->items[i] = std::move(ptr->items[i+1]);
+        --ptr->count;
+        --listSize;
+        if (ptr->count == 0){
+            node *next = ptr->next;
+            unlink(ptr);
+            deleteNode(ptr);
+            return iterator(this, next, 0);
+        }
+        if (ptr->count < CAPACITY / 2){
+            // Merge with the next node, or into the previous node
+            if (ptr->next != nullptr && ptr->count + ptr->next->count <= CAPACITY){
+                mergeNext(ptr);
+            } else if (ptr->prev != nullptr && ptr->prev->count + ptr->count <= CAPACITY){
+                node *prev = ptr->prev;
+                index += prev->count;
+                mergeNext(prev);
+                ptr = prev;
+            }
+        }
+        if (index == ptr->count)
+            return iterator(this, ptr->next, 0);
+        return iterator(this, ptr, index);
     }
 
-    // clear() and empty()
     void clear() {
-        clear(root);
+        while (first != nullptr){
+            node *next = first->next;
+            deleteNode(first);
+            first = next;
+        }
+        last = nullptr;
+        listSize = 0;
     }
-    bool empty() const {
-        return root == nullptr;
+
+    // Visit every element in order, a plain loop over each node array.
+    template <typename Func>
+    void forEach(Func f) const {
+        for (node *ptr = first; ptr != nullptr; ptr = ptr->next)
+            for (unsigned i = 0; i < ptr->count; ++i)
+                f(ptr->items[i]);
+    }
+
+    // Print the list to output
+    void print(std::ostream &output) const {
+        output << "[";
+        bool firstItem = true;
+        forEach([&](const T &val){
+            output << (firstItem ? "" : ", ") << val;
+            firstItem = false;
+        });
+        output << "]" << endl;
     }
 
 private:
-    // Tree root
-    myBinaryTreeNode<string> *root = nullptr;
+    node *first = nullptr;
+    node *last = nullptr;
+    unsigned listSize = 0;
+    myAllocStats stats;
 
-    // Private real print function, using pointer as first parameter
-    void printInfix(myBinaryTreeNode<string> *node, std::ostream &output) const {
-        if (node == nullptr) return;
-        printInfix(node->left, output);
-        output << node->value << " ";
-        printInfix(node->right, output);
-    }
-    void printPostfix(myBinaryTreeNode<string> *node, std::ostream &output) const {
-        if (node == nullptr) return;
-        printPostfix(node->left, output);
-        printPostfix(node->right, output);
-        output << node->value << " ";
+    node *newNode() {
+        stats.onAlloc(sizeof(node));
+        return new node;
     }
-    void printPrefix(myBinaryTreeNode<string> *node, std::ostream &output) const {
-        if (node == nullptr) return;
-        output << node->value << " ";
-        printPrefix(node->left, output);
-        printPrefix(node->right, output);
+    void deleteNode(node *ptr) {
+        stats.onFree(sizeof(node));
+        delete ptr;
     }
-
-    // Private real clear function, using pointer as parameter
-    // Attention: Here use reference of the pointer to node. So the pointer can be set as nullptr.
-    void clear(myBinaryTreeNode<string> *&node) {
-        if (node == nullptr) return;
-        clear(node->left);
-        clear(node->right);
-        delete node;
-        // Set pointer to nullptr
-        node = nullptr;      
+    // Link ptr after pos, pos == nullptr means the list is empty.
+    void linkAfter(node *pos, node *ptr) {
+        ptr->prev = pos;
+        ptr->next = pos == nullptr ? nullptr : pos->next;
+        if (pos == nullptr) first = ptr;
+        else pos->next = ptr;
+        if (ptr->next == nullptr) last = ptr;
+        else ptr->next->prev = ptr;
+    }
+    void unlink(node *ptr) {
+        if (ptr->prev == nullptr) first = ptr->next;
+        else ptr->prev->next = ptr->next;
+        if (ptr->next == nullptr) last = ptr->prev;
+        else ptr->next->prev = ptr->prev;
+    }
+    // Move all elements of ptr->next into ptr, and delete ptr->next.
+    void mergeNext(node *ptr) {
+        node *next = ptr->next;
+        for (unsigned i = 0; i < next->count; ++i)
+            ptr->items[ptr->count + i] = std::move(next->items[i]);
+        ptr->count += next->count;
+        unlink(next);
+        deleteNode(next);
     }
 };
 
 
 //
-//  Binary Search Tree (BST):
-//  node->values repeat is not allowed
+//  Stack implementation:
+//   1. Array stack with N elements of inline storage, it only allocates when more than N elements are pushed.
+//      Then it moves to a heap array, which doubles when full.
+//   2. myStack<T> (N = 0) always uses the heap array, like the former std::vector version.
 //
-template <typename T>
-class myBST{
+
+template <typename T, unsigned N = 0>
+class myStack{
 public:
-    // Constructors
-    myBST() = default;
-    // Copy constructor
-    myBST(const myBST<T> &rhs){
-        root = clone(rhs.root);
+    myStack() = default;
+    myStack(const myStack &rhs) {
+        reserve(rhs.count);
+        for (unsigned i = 0; i < rhs.count; ++i)
+            ::new (static_cast<void *>(list + i)) T(rhs.list[i]);
+        count = rhs.count;
+    }
+    myStack(myStack &&rhs) noexcept {
+        moveFrom(rhs);
+    }
+    myStack &operator=(const myStack &rhs) {
+        if (this != &rhs){
+            myStack copy(rhs);
+            clear();
+            release();
+            moveFrom(copy);
+        }
+        return *this;
     }
-    // Move constructor
-    myBST(myBST<T> &&rhs){
-        root = rhs.root;
+    myStack &operator=(myStack &&rhs) noexcept {
+        if (this != &rhs){
+            clear();
+            release();
+            moveFrom(rhs);
+        }
+        return *this;
     }
-    // Destructor
-    ~myBST(){
-        clear(root);
+    ~myStack() {
+        clear();
+        release();
     }
 
-    // Get the minimum and maximum value
-    T min() const {
-        return min(root);
+    T top() const {
+        if (empty()){
+            cerr << "Error: cannot get the top element of empty stack." << endl;
+            return {};
+        }
+        return list[count - 1];
     }
-    T max() const {
-        return max(root);
+    void pop() {
+        if (empty()){
+            cerr << "Error: cannot apply pop() on empty stack." << endl;
+            return;
+        }
+        list[--count].~T();
     }
-    // Whether contain val
-    bool contain(T val) const {
-        return contain(root, val);
+    // Left reference input
+    void push(const T &elem){
+        emplace(elem);
+    }
+    // Right reference input
+    void push(T &&elem){
+        emplace(std::move(elem));
+    }
+    template <typename... Args>
+    void emplace(Args&&... args){
+        if (count == cap)
+            reserve(cap == 0 ? 8 : cap * 2);
+        ::new (static_cast<void *>(list + count)) T(std::forward<Args>(args)...);
+        ++count;
     }
-    // empty and clear
     bool empty() const {
-        return root == nullptr;
+        return count == 0;
     }
     void clear() {
-        clear(root);
-    }
-
-    // insert and remove
-    void insert(const T &val) {
-        insert(root, val);
+        while (count > 0)
+            list[--count].~T();
     }
-    void insert(T &&val){
-        insert(root, std::move(val));
+    unsigned size() const {
+        return count;
     }
-    void remove(const T &val){
-        remove(root, val);
+    // Whether the elements are in the heap array
+    bool onHeap() const {
+        return list != inlineList();
     }
-    void remove(T &&val){
-        // Remove a right reference is of no profit
-        // So I just use left reference again
-        remove(root, val);
+private:
+    alignas(T) unsigned char buffer[(N > 0 ? N : 1) * sizeof(T)];
+    T *list = inlineList();
+    unsigned count = 0;
+    unsigned cap = N;
+
+    T *inlineList() {
+        return reinterpret_cast<T *>(buffer);
+    }
+    const T *inlineList() const {
+        return reinterpret_cast<const T *>(buffer);
+    }
+    // Move elements to a heap array of at least n elements.
+    void reserve(unsigned n) {
+        if (n <= cap) return;
+        T *newList = std::allocator<T>().allocate(n);
+        for (unsigned i = 0; i < count; ++i){
+            ::new (static_cast<void *>(newList + i)) T(std::move(list[i]));
+            list[i].~T();
+        }
+        release();
+        list = newList;
+        cap = n;
+    }
+    // Free the heap array, elements should be destroyed or moved already.
+    void release() {
+        if (onHeap())
+            std::allocator<T>().deallocate(list, cap);
+        list = inlineList();
+        cap = N;
+    }
+    // Take the elements of rhs, which is left empty.
+    void moveFrom(myStack &rhs) {
+        if (rhs.onHeap()){
+            list = rhs.list;
+            cap = rhs.cap;
+            count = rhs.count;
+            rhs.list = rhs.inlineList();
+            rhs.cap = N;
+            rhs.count = 0;
+        } else {
+            for (unsigned i = 0; i < rhs.count; ++i)
+                ::new (static_cast<void *>(list + i)) T(std::move(rhs.list[i]));
+            count = rhs.count;
+            rhs.clear();
+        }
     }
+};
 
-private:
-    // Inner node structure
-    struct node{
-        T value;
-        node *left = nullptr;
-        node *right = nullptr;
 
-        // Constructors
-        node() = default;
-        node(const T &val, node *l, node *r):
-            value(val), left(l), right(r){}
-        node(T &&val, node *l, node *r):
-            value(std::move(val)), left(l), right(r){}
-    };
-    
-    // The only member variable
-    node *root = nullptr;
+//
+//  Queue implementation:
+//   1. Circular array with power-of-two capacity, so wraparound is a mask instead of a compare.
+//   2. Storage is raw memory, elements are constructed in place and destroyed on pop,
+//      so move-only types are supported.
+//   3. push_bulk() and pop_bulk() move a span as at most two contiguous segments,
+//      which are plain memcpy for trivially copyable types.
+//
+template <typename T>
+class myQueue{
+public:
+    myQueue():
+        capacity(INITSIZE), listSize(0), start(0){
+        list = allocate(capacity);
+    }
+    myQueue(const myQueue &rhs):
+        capacity(rhs.capacity), listSize(0), start(0){
+        list = allocate(capacity);
+        for (unsigned i = 0; i < rhs.listSize; ++i)
+            push(rhs.list[rhs.index(i)]);
+    }
+    myQueue(myQueue &&rhs) noexcept:
+        list(rhs.list), capacity(rhs.capacity), listSize(rhs.listSize), start(rhs.start){
+        rhs.list = nullptr;
+        rhs.capacity = 0;
+        rhs.listSize = 0;
+        rhs.start = 0;
+    }
+    myQueue &operator=(myQueue rhs){
+        swap(rhs);
+        return *this;
+    }
+    ~myQueue(){
+        clear();
+        deallocate(list, capacity);
+    }
+    void swap(myQueue &rhs) noexcept {
+        std::swap(list, rhs.list);
+        std::swap(capacity, rhs.capacity);
+        std::swap(listSize, rhs.listSize);
+        std::swap(start, rhs.start);
+    }
 
-    // Return a clone of the tree pointed by ptr
-    node *clone(node *ptr){
-        if (ptr == nullptr) return nullptr;
-        return new node{ptr->value, clone(ptr->left), clone(ptr->right)};
+    void push(const T &elem){
+        emplace(elem);
     }
-    // Private versions of all routines
-    T min(node *ptr) const {
-        if (ptr == nullptr) {
-            cerr << "Error: cannot get min value of nullptr" << endl;
-            return {};
+    void push(T &&elem){
+        emplace(std::move(elem));
+    }
+    // Construct the element in place at the back, return reference to it.
+    template <typename... Args>
+    T &emplace(Args&&... args){
+        if (listSize == capacity){
+            // args may refer to an element of this queue, build the new element
+            // in the new array before the old ones are moved out of it.
+            unsigned newCapacity = capacity == 0 ? INITSIZE : capacity * 2;
+            T *newList = allocate(newCapacity);
+            try {
+                ::new (static_cast<void *>(newList + listSize)) T(std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(newList, newCapacity);
+                throw;
+            }
+            adopt(newList, newCapacity);
+            return list[listSize++];
         }
-        T result = ptr->value;
-        if (ptr->left != nullptr)
-            result = std::min(result, min(ptr->left));
-        if (ptr->right != nullptr)
-            result = std::min(result, min(ptr->right));
-        return result;
+        T *ptr = list + index(listSize);
+        ::new (static_cast<void *>(ptr)) T(std::forward<Args>(args)...);
+        ++listSize;
+        return *ptr;
     }
-    T max(node *ptr) const {
-        if (ptr == nullptr) {
-            cerr << "Error: cannot get max value of nullptr" << endl;
-            return {};
+    void pop(){
+        if (empty()){
+            cerr << "Error: cannot apply pop() on empty queue." << endl;
+            return;
         }
-        T result = ptr->value;
-        if (ptr->left != nullptr)
-            result = std::max(result, max(ptr->left));
-        if (ptr->right != nullptr)
-            result = std::max(result, max(ptr->right));
-        return result;
+        list[start].~T();
+        start = (start + 1) & (capacity - 1);
+        --listSize;
     }
-    bool contain(node *ptr, T val) const {
-        if (ptr == nullptr) return false;
-        return ptr->value == val || contain(ptr->left, val) || contain(ptr->right, val);
+
+    // Push n elements from data, in order.
+    void push_bulk(const T *data, unsigned n){
+        if (n > MAXCAPACITY - listSize){
+            cerr << "Error: queue cannot hold more than " << MAXCAPACITY << " elements." << endl;
+            return;
+        }
+        reserve(listSize + n);
+        unsigned pos = index(listSize);
+        unsigned first = std::min(n, capacity - pos);
+        copySpan(list + pos, data, first);
+        copySpan(list, data + first, n - first);
+        listSize += n;
+    }
+    // Pop at most n elements into out, return the number popped.
+    unsigned pop_bulk(T *out, unsigned n){
+        n = std::min(n, listSize);
+        unsigned first = std::min(n, capacity - start);
+        moveSpan(out, list + start, first);
+        moveSpan(out + first, list, n - first);
+        start = (start + n) & (capacity - 1);
+        listSize -= n;
+        return n;
     }
-    void clear(node *&ptr){
-        if (ptr == nullptr) return;
-        clear(ptr->left);
-        clear(ptr->right);
-        delete ptr;
-        ptr = nullptr;
+
+    // Change the array to new one with double capacity.
+    void resize() {
+        grow(capacity == 0 ? INITSIZE : capacity * 2);
+    }
+    // Make capacity at least n.
+    void reserve(unsigned n) {
+        if (n <= capacity) return;
+        if (n > MAXCAPACITY){
+            cerr << "Error: queue cannot hold more than " << MAXCAPACITY << " elements." << endl;
+            return;
+        }
+        unsigned newCapacity = capacity == 0 ? INITSIZE : capacity;
+        while (newCapacity < n) newCapacity *= 2;
+        grow(newCapacity);
+    }
+    T &front() {
+        return list[start];
+    }
+    T &back() {
+        return list[index(listSize - 1)];
+    }
+    const T &front() const {
+        return list[start];
+    }
+    const T &back() const {
+        return list[index(listSize - 1)];
     }
+    bool empty() const {
+        return listSize == 0;
+    }
+    void clear() {
+        if constexpr (!std::is_trivially_destructible<T>::value)
+            for (unsigned i = 0; i < listSize; ++i)
+                list[index(i)].~T();
+        start = 0;
+        listSize = 0;
+    }
+    unsigned size() const {
+        return listSize;
+    }
+    
+private:
+    // Initial capacity of real array, must be power of two
+    static constexpr unsigned INITSIZE = 16;
+    // Largest power of two capacity an unsigned can hold
+    static constexpr unsigned MAXCAPACITY = 1u << 31;
+    T *list;
+    // Capacity is the real capacity of the array, always power of two
+    unsigned capacity;
+    // listSize is the size of valid data
+    unsigned listSize;
+    // Start is the position of the front element
+    unsigned start;
 
-    // Real insert routine
-    void insert(node *&ptr, const T &val){
-        if (ptr == nullptr){
-            auto newNode = new node{val, nullptr, nullptr};
-            ptr = newNode;
-        } else if (ptr->value > val){
-            insert(ptr->left, val);
-        } else if (ptr->value < val){
-            insert(ptr->right, val);
+    // Array position of the i-th element from front
+    unsigned index(unsigned i) const {
+        return (start + i) & (capacity - 1);
+    }
+    static T *allocate(unsigned n) {
+        return std::allocator<T>().allocate(n);
+    }
+    static void deallocate(T *ptr, unsigned n) {
+        if (ptr != nullptr)
+            std::allocator<T>().deallocate(ptr, n);
+    }
+    // Move all elements to a new array of newCapacity, front at position 0.
+    void grow(unsigned newCapacity) {
+        adopt(allocate(newCapacity), newCapacity);
+    }
+    // Move all elements to newList of newCapacity, front at position 0, and free the old array.
+    void adopt(T *newList, unsigned newCapacity) {
+        unsigned first = std::min(listSize, capacity - start);
+        relocate(newList, list + start, first);
+        relocate(newList + first, list, listSize - first);
+        deallocate(list, capacity);
+        list = newList;
+        capacity = newCapacity;
+        start = 0;
+    }
+    // Copy construct n elements into raw memory.
+    static void copySpan(T *dest, const T *src, unsigned n) {
+        if constexpr (std::is_trivially_copyable<T>::value){
+            if (n) std::memcpy(static_cast<void *>(dest), src, n * sizeof(T));
         } else {
-            // cerr << "Error: inserted value already exist." <<  endl;
+            for (unsigned i = 0; i < n; ++i)
+                ::new (static_cast<void *>(dest + i)) T(src[i]);
         }
     }
-    void insert(node *&ptr, T &&val){
-        if (ptr == nullptr){
-            auto newNode = new node{std::move(val), nullptr, nullptr};
-            ptr = newNode;
-        } else if (ptr->value > val){
-            insert(ptr->left, std::move(val));
-        } else if (ptr->value < val){
-            insert(ptr->right, std::move(val));
+    // Move n elements into constructed objects, and destroy the sources.
+    static void moveSpan(T *dest, T *src, unsigned n) {
+        if constexpr (std::is_trivially_copyable<T>::value){
+            if (n) std::memcpy(static_cast<void *>(dest), src, n * sizeof(T));
         } else {
-            // cerr << "Error: inserted value already exist." <<  endl;
+            for (unsigned i = 0; i < n; ++i){
+                dest[i] = std::move(src[i]);
+                src[i].~T();
+            }
         }
     }
-
-    // Real remove routine
-    void remove(node *&ptr, const T &val){
-        if (ptr == nullptr){
-            // cerr << "Error: removed value dosen't exist." << endl;
-            return;
-        }
-        if (ptr->value > val) remove(ptr->left, val);
-        else if (ptr->value < val) remove(ptr->right, val);
-        else {
-            // For leaf nodes
-            if (ptr->left == nullptr && ptr->right == nullptr){
-                delete ptr;
-                ptr = nullptr;
-            } else if (ptr->left == nullptr){
-                // For nodes with only one child at right branch
-                auto p = ptr;
-                ptr = ptr->left;
-                delete p;
-            } else if (ptr->right == nullptr){
-                // For nodes with only one child at left branch
-                auto p = ptr;
-                ptr = ptr->right;
-                delete p;
-            } else {
-                // For nodes with two children, find the max of right child,
-                // and move the max value to the node, recursively remove the max node.
-                auto rightMin = min(ptr->right);
-                ptr->value = rightMin;
-                remove(ptr->right, rightMin);
+    // Move construct n elements into raw memory, and destroy the sources.
+    static void relocate(T *dest, T *src, unsigned n) {
+        if constexpr (std::is_trivially_copyable<T>::value){
+            if (n) std::memcpy(static_cast<void *>(dest), src, n * sizeof(T));
+        } else {
+            for (unsigned i = 0; i < n; ++i){
+                ::new (static_cast<void *>(dest + i)) T(std::move(src[i]));
+                src[i].~T();
             }
         }
     }
@@ -866,410 +2044,3296 @@ private:
 
 
 //
-//  AVL Tree:
-//   Bias is the allowed imbalance of the AVL tree which is set as a private member variable.
+//  Pause instruction for spin loops, lets the sibling hyper-thread run.
+//
+void cpuRelax() {
+# if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+# else
+    std::this_thread::yield();
+# endif
+}
+
+//
+//  Single-producer / single-consumer queue:
+//   1. Circular array of myQueue with fixed power-of-two capacity, one thread pushes and one thread pops.
+//   2. Head and tail are atomic indices on separate cache lines, published with release and read with acquire.
+//      Each side keeps a cached copy of the other side's index, and only reloads it when the queue looks full or empty.
+//   3. try_push() and try_pop() never wait. push() and pop() wait by mode:
+//       "Spin"  - busy wait with pause instruction, yield the time slice after a while.
+//       "Block" - spin for a while, then sleep on a condition variable.
+//                 The other side only takes the mutex when a waiter flag is set, and waits time out as a safety net.
 //
 template <typename T>
-class myAVLTree{
+class mySPSCQueue {
 public:
-    myAVLTree() = default;
-    // You can choose to pass a bias value as b, if you want to change bias. And b should be non-negative.
-    myAVLTree(const myAVLTree &rhs, int b = 1){
-        if (b < 0) {
-            cerr << "Error: bias should be non-negative." << endl;
-            return;
+    explicit mySPSCQueue(unsigned capacity = 1024, const string &mode = "Spin") {
+        if (mode == "Block") blocking = true;
+        else if (mode != "Spin")
+            cerr << "Error: unknown SPSC queue mode " << mode << ", use Spin instead." << endl;
+        cap = 2;
+        while (cap < capacity) cap *= 2;
+        mask = cap - 1;
+        list = std::allocator<T>().allocate(cap);
+    }
+    mySPSCQueue(const mySPSCQueue &) = delete;
+    mySPSCQueue &operator=(const mySPSCQueue &) = delete;
+    ~mySPSCQueue() {
+        for (size_t i = head.load(); i != tail.load(); ++i)
+            list[i & mask].~T();
+        std::allocator<T>().deallocate(list, cap);
+    }
+
+    // Producer side.
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == cap){
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == cap) return false;
         }
-        root = clone(rhs.root);
-        bias = b;
+        ::new (static_cast<void *>(list + (t & mask))) T(std::forward<Args>(args)...);
+        tail.store(t + 1, std::memory_order_release);
+        if (blocking) wake(consumerWaiting);
+        return true;
     }
-    myAVLTree(myAVLTree &&rhs, int b = 1){
-        if (b < 0) {
-            cerr << "Error: bias should be non-negative." << endl;
-            return;
+    bool try_push(const T &elem) {
+        return try_emplace(elem);
+    }
+    bool try_push(T &&elem) {
+        return try_emplace(std::move(elem));
+    }
+    void push(const T &elem) {
+        for (unsigned spin = 0; !try_push(elem); ++spin)
+            wait(spin, producerWaiting, [this]{ return !full(); });
+    }
+    void push(T &&elem) {
+        for (unsigned spin = 0; !try_push(std::move(elem)); ++spin)
+            wait(spin, producerWaiting, [this]{ return !full(); });
+    }
+
+    // Consumer side.
+    bool try_pop(T &out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache){
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache) return false;
         }
-        root = rhs;
-        bias = b;
+        T *ptr = list + (h & mask);
+        out = std::move(*ptr);
+        ptr->~T();
+        head.store(h + 1, std::memory_order_release);
+        if (blocking) wake(producerWaiting);
+        return true;
     }
-    ~myAVLTree(){
-        clear(root);
+    void pop(T &out) {
+        for (unsigned spin = 0; !try_pop(out); ++spin)
+            wait(spin, consumerWaiting, [this]{ return !empty(); });
     }
-    void clear() {
-        clear(root);
+
+    // Approximate when the other side is running.
+    unsigned size() const {
+        return static_cast<unsigned>(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
     }
     bool empty() const {
-        return root == nullptr;
+        return size() == 0;
+    }
+    bool full() const {
+        return size() == cap;
+    }
+    unsigned capacity() const {
+        return cap;
     }
 
-    // Get the height of the tree.
-    int getHeight() const {
-        return getHeight(root);
+private:
+    // Spin rounds before yield or sleep
+    static constexpr unsigned SPIN_LIMIT = 256;
+
+    // Consumer cache line: head index and cached tail
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tailCache = 0;
+    // Producer cache line: tail index and cached head
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t headCache = 0;
+    // Read-only after construction
+    alignas(64) T *list = nullptr;
+    unsigned cap = 0;
+    size_t mask = 0;
+    bool blocking = false;
+    // Blocking mode
+    std::atomic<bool> producerWaiting{false};
+    std::atomic<bool> consumerWaiting{false};
+    std::mutex waitMutex;
+    std::condition_variable waitCond;
+
+    // One failed round of push() or pop(), ready() checks whether to retry.
+    template <typename Ready>
+    void wait(unsigned spin, std::atomic<bool> &waiting, Ready ready) {
+        if (spin < SPIN_LIMIT){
+            cpuRelax();
+            return;
+        }
+        if (!blocking){
+            std::this_thread::yield();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready())
+            waitCond.wait_for(lock, std::chrono::milliseconds(1));
+        waiting.store(false);
+    }
+    // Wake the other side if it is sleeping.
+    void wake(std::atomic<bool> &waiting) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)){
+            { std::lock_guard<std::mutex> lock(waitMutex); }
+            waitCond.notify_all();
+        }
     }
+};
 
-    // find the maximum and minimum
-    T max() const {
-        node *maxNode = max(root);
-        if (maxNode == nullptr){
-            cerr << "Error: cannot get the maximum of empty tree." << endl;
-            return {};
+//
+//  Bounded multi-producer / multi-consumer queue (Vyukov):
+//   1. Circular array of power-of-two capacity, each slot has a sequence number.
+//      Slot i is free for the push of position pos when seq == pos, and full for the pop of pos when seq == pos + 1.
+//   2. Producers and consumers claim positions with compare-exchange on their own cache line,
+//      the slot sequence published with release passes the element to the other side. No locks.
+//   3. Same push / pop / size vocabulary as myQueue. try_push() and try_pop() return false when full or empty,
+//      push() and pop() spin and then yield until they succeed.
+//
+template <typename T>
+class myMPMCQueue {
+public:
+    explicit myMPMCQueue(unsigned capacity = 1024) {
+        cap = 2;
+        while (cap < capacity) cap *= 2;
+        mask = cap - 1;
+        slots = new slot[cap];
+        for (size_t i = 0; i < cap; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    myMPMCQueue(const myMPMCQueue &) = delete;
+    myMPMCQueue &operator=(const myMPMCQueue &) = delete;
+    ~myMPMCQueue() {
+        for (size_t pos = popPos.load(); pos != pushPos.load(); ++pos)
+            slots[pos & mask].element()->~T();
+        delete[] slots;
+    }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        size_t pos = pushPos.load(std::memory_order_relaxed);
+        slot *cell;
+        while (true){
+            cell = &slots[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0){
+                if (pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0){
+                return false;   // full
+            } else {
+                pos = pushPos.load(std::memory_order_relaxed);
+            }
         }
-        return maxNode->value;
+        ::new (static_cast<void *>(cell->storage)) T(std::forward<Args>(args)...);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
     }
-    T min() const {
-        node *minNode = min(root);
-        if (minNode == nullptr){
-            cerr << "Error: cannot get the minimum of empty tree." << endl;
-            return {};
+    bool try_push(const T &elem) {
+        return try_emplace(elem);
+    }
+    bool try_push(T &&elem) {
+        return try_emplace(std::move(elem));
+    }
+    bool try_pop(T &out) {
+        size_t pos = popPos.load(std::memory_order_relaxed);
+        slot *cell;
+        while (true){
+            cell = &slots[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (diff == 0){
+                if (popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0){
+                return false;   // empty
+            } else {
+                pos = popPos.load(std::memory_order_relaxed);
+            }
         }
-        return minNode->value;
+        T *ptr = cell->element();
+        out = std::move(*ptr);
+        ptr->~T();
+        cell->seq.store(pos + cap, std::memory_order_release);
+        return true;
     }
-
-    // public contain, insert and remove, just like them in myBST.
-    bool contain(const T&val) const {
-        return contain(val, root);
+    void push(const T &elem) {
+        for (unsigned spin = 0; !try_push(elem); ++spin)
+            backoff(spin);
     }
-    void insert(const T &val) {
-        insert(val, root);
+    void push(T &&elem) {
+        for (unsigned spin = 0; !try_push(std::move(elem)); ++spin)
+            backoff(spin);
     }
-    void insert(T &&val){
-        insert(std::move(val), root);
+    void pop(T &out) {
+        for (unsigned spin = 0; !try_pop(out); ++spin)
+            backoff(spin);
     }
-    void remove(const T &val){
-        remove(val, root);
+
+    // Approximate when other threads are running.
+    unsigned size() const {
+        size_t push = pushPos.load(std::memory_order_acquire);
+        size_t pop = popPos.load(std::memory_order_acquire);
+        return push > pop ? static_cast<unsigned>(std::min<size_t>(push - pop, cap)) : 0;
     }
-    void remove(T &&val){
-        remove(val, root);
+    bool empty() const {
+        return size() == 0;
     }
+    unsigned capacity() const {
+        return cap;
+    }
+
 private:
-    // inner node structure, there is a height member additional
-    struct node {
-        T value;
-        node *left = nullptr;
-        node *right = nullptr;
-        int height = 0;
-        node(const T &val, node *l, node *r, int h):
-            value(val), left(l), right(r), height(h) {}
-        node(T &&val, node *l, node *r, int h):
-            value(std::move(val)), left(l), right(r), height(h) {}
+    struct slot {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T *element() {
+            return reinterpret_cast<T *>(storage);
+        }
     };
-    // get the height of the node. For convenience, we set height of nullptr as -1.
-    int getHeight(node *ptr) const {
-        return ptr == nullptr ? -1 : ptr->height;
+    // Spin rounds before yield
+    static constexpr unsigned SPIN_LIMIT = 64;
+
+    alignas(64) std::atomic<size_t> pushPos{0};
+    alignas(64) std::atomic<size_t> popPos{0};
+    alignas(64) slot *slots = nullptr;
+    size_t cap = 0;
+    size_t mask = 0;
+
+    static void backoff(unsigned spin) {
+        if (spin < SPIN_LIMIT) cpuRelax();
+        else std::this_thread::yield();
     }
-    // return a clone of the node structure.
-    node *clone(node *ptr) const {
-        if (ptr == nullptr) return nullptr;
-        return new node{ptr->value, clone(ptr->left), clone(ptr->right), ptr->height};
+};
+
+//
+//  Queue benchmark:
+//   1. Producer threads push items stamped with steady_clock time, consumer threads pop them.
+//      Every latencySample-th item is stamped, its push-to-pop latency goes into pStats.
+//   2. spscBenchmark() compares mySPSCQueue in "Spin" and "Block" mode with a mutex-wrapped myQueue of the same capacity.
+//      mpmcBenchmark() compares myMPMCQueue with the mutex-wrapped myQueue from 1 thread per side to all cores.
+//   3. queueBenchReport() prints results as "Table", "CSV" or "JSON".
+//
+
+// Configuration of queue benchmarks
+struct queueBenchConfig {
+    unsigned items = 1000000;       // items per producer
+    unsigned capacity = 1024;
+    unsigned latencySample = 64;
+};
+
+// Result of one queue under one thread setting
+struct queueBenchResult {
+    string queue;
+    unsigned producers = 1;
+    unsigned consumers = 1;
+    unsigned items = 0;             // total items through the queue
+    double seconds = 0;
+    double opsPerSec = 0;
+    pStats latencyNs;
+};
+
+//
+// Mutex-wrapped myQueue with bounded capacity, the baseline of queue benchmarks.
+//
+template <typename T>
+class myLockedQueue {
+public:
+    explicit myLockedQueue(unsigned capacity = 1024): cap(capacity) {}
+    bool try_push(const T &elem) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.size() >= cap) return false;
+        queue.push(elem);
+        return true;
     }
-    void clear(node *&ptr) {
-        if (ptr == nullptr) return;
-        clear(ptr->left);
-        clear(ptr->right);
-        delete ptr;
-        ptr = nullptr;
+    bool try_pop(T &out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.empty()) return false;
+        out = std::move(queue.front());
+        queue.pop();
+        return true;
     }
-    node *max(node *ptr) const {
-        if (ptr == nullptr) return nullptr;
-        node *maxNode = ptr;
-        while (maxNode->right != nullptr)
-            maxNode = maxNode->right;
-        return maxNode;
+    void push(const T &elem) {
+        while (!try_push(elem))
+            std::this_thread::yield();
     }
-    node *min(node* ptr) const {
-        if (ptr == nullptr) return nullptr;
-        node *minNode = ptr;
-        while (minNode->left != nullptr)
-            minNode = minNode->left;
-        return minNode;
+    void pop(T &out) {
+        while (!try_pop(out))
+            std::this_thread::yield();
     }
-    bool contain(const T &val, node *ptr) const {
-        if (ptr == nullptr) return false;
-        if (val < ptr->value) return contain(val, ptr->left);
-        if (val > ptr->value) return contain(val, ptr->right);
-        return true;
+private:
+    std::mutex mtx;
+    myQueue<T> queue;
+    unsigned cap;
+};
+
+// Nanoseconds of steady_clock, the stamp of benchmark items (never 0).
+uint64_t queueBenchStamp() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count()) | 1;
+}
+
+//
+// Run producers and consumers on queue q, which has push(uint64_t) and pop(uint64_t&).
+// Items are split evenly between consumers.
+//
+template <typename queueType>
+queueBenchResult queueBenchRun(queueType &q, const string &name, unsigned producers, unsigned consumers,
+                               const queueBenchConfig &config = queueBenchConfig()) {
+    queueBenchResult res;
+    res.queue = name;
+    res.producers = producers;
+    res.consumers = consumers;
+    res.items = config.items * producers;
+    unsigned sample = std::max(config.latencySample, 1u);
+    vector<vector<double>> latency(consumers);
+    vector<std::thread> threads;
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    auto startLine = [&]{
+        ++ready;
+        while (!go.load()) std::this_thread::yield();
+    };
+    for (unsigned p = 0; p < producers; ++p)
+        threads.emplace_back([&]{
+            startLine();
+            for (unsigned i = 0; i < config.items; ++i)
+                q.push(i % sample == 0 ? queueBenchStamp() : 0);
+        });
+    for (unsigned c = 0; c < consumers; ++c)
+        threads.emplace_back([&, c]{
+            unsigned count = res.items / consumers + (c < res.items % consumers ? 1 : 0);
+            latency[c].reserve(count / sample + 1);
+            startLine();
+            uint64_t item = 0;
+            for (unsigned i = 0; i < count; ++i){
+                q.pop(item);
+                if (item != 0)
+                    latency[c].push_back(static_cast<double>(queueBenchStamp() - item));
+            }
+        });
+    while (ready.load() != producers + consumers) std::this_thread::yield();
+    auto begin = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto &t : threads) t.join();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    res.opsPerSec = res.items / res.seconds;
+    vector<double> all;
+    for (auto &v : latency) all.insert(all.end(), v.begin(), v.end());
+    res.latencyNs = pStats::of(std::move(all));
+    return res;
+}
+
+vector<queueBenchResult> spscBenchmark(const queueBenchConfig &config = queueBenchConfig()) {
+    vector<queueBenchResult> results;
+    {
+        mySPSCQueue<uint64_t> q(config.capacity, "Spin");
+        results.push_back(queueBenchRun(q, "SPSC Spin", 1, 1, config));
+    }
+    {
+        mySPSCQueue<uint64_t> q(config.capacity, "Block");
+        results.push_back(queueBenchRun(q, "SPSC Block", 1, 1, config));
+    }
+    {
+        myLockedQueue<uint64_t> q(config.capacity);
+        results.push_back(queueBenchRun(q, "Mutex myQueue", 1, 1, config));
     }
+    return results;
+}
 
-    // In AVL tree, insert and remove routines should apply balance() routine to balance the AVL tree.
-    void insert(const T &val, node *&ptr) {
-        if (ptr == nullptr) {
-            node *newNode = new node{val, nullptr, nullptr, 0};
-            ptr = newNode;
-        } else if (val < ptr->value){
-            insert(val, ptr->left);
-        } else if (val > ptr->value){
-            insert(val, ptr->right);
-        } else {
-            // cerr << "Error: inserted value already exists." << endl;
-            return;
+//
+// Scalability of myMPMCQueue against mutex-wrapped myQueue.
+// Producers and consumers go 1, 2, 4, ... per side until both sides together use all hardware threads.
+// Each producer pushes config.items / producers items, so the total is the same for every thread count.
+//
+vector<queueBenchResult> mpmcBenchmark(const queueBenchConfig &config = queueBenchConfig()) {
+    vector<queueBenchResult> results;
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 2u);
+    vector<unsigned> sides;
+    for (unsigned t = 1; t * 2 < cores; t *= 2)
+        sides.push_back(t);
+    if (sides.empty() || sides.back() != cores / 2)
+        sides.push_back(cores / 2);
+    for (auto t : sides){
+        queueBenchConfig cfg = config;
+        cfg.items = std::max(config.items / t, 1u);
+        {
+            myMPMCQueue<uint64_t> q(config.capacity);
+            results.push_back(queueBenchRun(q, "MPMC", t, t, cfg));
+        }
+        {
+            myLockedQueue<uint64_t> q(config.capacity);
+            results.push_back(queueBenchRun(q, "Mutex myQueue", t, t, cfg));
         }
-        // Additional balance routine
-        balance(ptr);
     }
-    void insert(T &&val, node *&ptr){
-        if (ptr == nullptr){
-            node *newNode = new node{std::move(val), nullptr, nullptr, 0};
-            ptr = newNode;
-        } else if (val < ptr->value){
-            insert(val, ptr->left);
-        } else if (val > ptr->value){
-            insert(val, ptr->right);
-        } else {
-            // cerr << "Error: inserted value already exists." << endl;
-            return;
+    return results;
+}
+
+void queueBenchReport(const vector<queueBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(18) << "queue" << std::right << std::setw(11) << "producers" << std::setw(11) << "consumers"
+           << std::setw(14) << "ops/sec" << std::setw(12) << "lat p50" << std::setw(12) << "lat p95"
+           << std::setw(12) << "lat p99" << std::setw(14) << "lat max" << endl;
+        for (auto &r : results)
+            os << std::left << std::setw(18) << r.queue << std::right << std::setw(11) << r.producers << std::setw(11) << r.consumers
+               << std::setw(14) << static_cast<uint64_t>(r.opsPerSec) << std::setw(12) << r.latencyNs.median
+               << std::setw(12) << r.latencyNs.p95 << std::setw(12) << r.latencyNs.p99 << std::setw(14) << r.latencyNs.max << endl;
+    } else if (mode == "CSV"){
+        os << "queue,producers,consumers,items,seconds,ops_per_sec,latency_median_ns,latency_p95_ns,latency_p99_ns,latency_max_ns" << endl;
+        for (auto &r : results)
+            os << r.queue << "," << r.producers << "," << r.consumers << "," << r.items << "," << r.seconds << "," << r.opsPerSec
+               << "," << r.latencyNs.median << "," << r.latencyNs.p95 << "," << r.latencyNs.p99 << "," << r.latencyNs.max << endl;
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"queue\": \"" << r.queue << "\", \"producers\": " << r.producers
+               << ", \"consumers\": " << r.consumers << ", \"items\": " << r.items << ", \"seconds\": " << r.seconds
+               << ", \"ops_per_sec\": " << r.opsPerSec << ", \"latency_ns\": {\"count\": " << r.latencyNs.count
+               << ", \"median\": " << r.latencyNs.median << ", \"p95\": " << r.latencyNs.p95 << ", \"p99\": " << r.latencyNs.p99
+               << ", \"max\": " << r.latencyNs.max << "}}";
         }
-        balance(ptr);
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
     }
+}
 
-    void remove(const T &val, node *&ptr){
-        if (ptr == nullptr){
-            // cerr << "Error: removed value dosen't exist." << endl;
-            return;
-        } else if (val < ptr->value){
-            remove(val, ptr->left);
-        } else if (val > ptr->value){
-            remove(val, ptr->right);
-        } else {
-            if (ptr->left == nullptr && ptr->right == nullptr){
-                delete ptr;
-                ptr = nullptr;
-            } else if (ptr->left == nullptr){
-                ptr->value = ptr->right->value;
-                delete ptr->right;
-                ptr->right = nullptr;
-            } else if (ptr->right == nullptr){
-                ptr->value = ptr->left->value;
-                delete ptr->left;
-                ptr->left = nullptr;
-            } else {
-                node *rightMin = min(ptr->right);
-                ptr->value = rightMin->value;
-                remove(rightMin->value, rightMin);
+
+//
+//  Lock-free stack (Treiber) with optional elimination backoff:
+//   1. Nodes come from a fixed pool of capacity nodes and are addressed by 32-bit index.
+//      The stack and the free list are both Treiber stacks whose head word is (tag, index).
+//      Every successful CAS increments the tag, so a head popped and pushed back in between (ABA) fails the CAS.
+//      Nodes are never returned to the system, so reading the next index of a stale node is safe.
+//   2. mode = "Treiber"     - plain CAS retry loop.
+//      mode = "Elimination" - after a failed CAS, a push offers its node in a random slot of an elimination array
+//                             and a pop takes it from there, so the pair completes without touching the head.
+//   3. try_push() returns false when all nodes are used, try_pop() returns false when the stack is empty.
+//
+template <typename T>
+class myLockFreeStack {
+public:
+    explicit myLockFreeStack(unsigned capacity = 1024, const string &mode = "Treiber"):
+        cap(std::max(capacity, 1u)), nodes(new node[cap]) {
+        if (mode == "Elimination") elimination = true;
+        else if (mode != "Treiber")
+            cerr << "Error: unknown lock-free stack mode " << mode << ", use Treiber instead." << endl;
+        for (uint32_t i = 0; i < cap; ++i)
+            nodes[i].next.store(i + 1 < cap ? i + 1 : NIL, std::memory_order_relaxed);
+        freeList.store(pack(0, 0), std::memory_order_relaxed);
+    }
+    myLockFreeStack(const myLockFreeStack &) = delete;
+    myLockFreeStack &operator=(const myLockFreeStack &) = delete;
+    ~myLockFreeStack() {
+        for (uint32_t i = indexOf(head.load()); i != NIL; i = nodes[i].next.load())
+            nodes[i].element()->~T();
+        delete[] nodes;
+    }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        uint32_t i = popIndex(freeList);
+        if (i == NIL) return false;
+        ::new (static_cast<void *>(nodes[i].storage)) T(std::forward<Args>(args)...);
+        while (!tryPushIndex(head, i)){
+            if (elimination && eliminatePush(i)){
+                eliminatedCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
             }
-            balance(ptr);
         }
+        return true;
     }
-
-    // Critical in AVL tree!
-    // balance routine
-    void balance(node *&ptr) {
-        if (ptr == nullptr) return;
-        if (getHeight(ptr->left) - getHeight(ptr->right) > bias) {
-            // Left child overload, single rotate or double rotate
-            if (getHeight(ptr->left->left) > getHeight(ptr->left->right))
-                rotateLeft(ptr);
-            else
-                doubleRotateLeft(ptr);
-        } else if (getHeight(ptr->right) - getHeight(ptr->left) > bias) {
-            // Right child overload, single rotate or double rotate
-            if (getHeight(ptr->right->right) > getHeight(ptr->right->left))
-                rotateRight(ptr);
-            else
-                doubleRotateRight(ptr);
+    bool try_push(const T &elem) {
+        return try_emplace(elem);
+    }
+    bool try_push(T &&elem) {
+        return try_emplace(std::move(elem));
+    }
+    bool try_pop(T &out) {
+        uint32_t i;
+        uint64_t old = head.load(std::memory_order_acquire);
+        while (true){
+            i = indexOf(old);
+            if (i == NIL) return false;
+            uint32_t next = nodes[i].next.load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(old, pack(tagOf(old) + 1, next),
+                                           std::memory_order_acquire, std::memory_order_acquire))
+                break;
+            if (elimination && (i = eliminatePop()) != NIL)
+                break;
+            old = head.load(std::memory_order_acquire);
         }
-        // Put height update process in specific rotate routines
+        T *ptr = nodes[i].element();
+        out = std::move(*ptr);
+        ptr->~T();
+        pushIndex(freeList, i);
+        return true;
     }
 
-    // Single rotate with left child
-    void rotateLeft(node *&ptr) {
-        // Rotate
-        node *newPtr = ptr->left;
-        ptr->left = newPtr->right;
-        newPtr->right = ptr;
-        // Update height
-        ptr->height = std::max(getHeight(ptr->left), getHeight(ptr->right)) + 1;
-        newPtr->height = std::max(getHeight(newPtr->left), ptr->height) + 1;
-
-        ptr = newPtr;
+    // Approximate when other threads are running.
+    bool empty() const {
+        return indexOf(head.load(std::memory_order_acquire)) == NIL;
+    }
+    unsigned capacity() const {
+        return cap;
+    }
+    // Number of push / pop pairs completed in the elimination array
+    uint64_t eliminated() const {
+        return eliminatedCount.load(std::memory_order_relaxed);
     }
-    // Single rotate with right child
-    void rotateRight(node *&ptr) {
-        // Rotate
-        node *newPtr = ptr->right;
-        ptr->right = newPtr->left;
-        newPtr->left = ptr;
-        // Update height
-        ptr->height = std::max(getHeight(ptr->left), getHeight(ptr->right)) + 1;
-        newPtr->height = std::max(getHeight(ptr->right), ptr->height) + 1;
 
-        ptr = newPtr;
+private:
+    static constexpr uint32_t NIL = 0xffffffffu;
+    // Elimination array size, and spin rounds a push waits in it
+    static constexpr unsigned ELIMINATION_SLOTS = 16;
+    static constexpr unsigned ELIMINATION_SPIN = 64;
+
+    struct node {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::atomic<uint32_t> next{NIL};
+        T *element() {
+            return reinterpret_cast<T *>(storage);
+        }
+    };
+    struct alignas(64) slot {
+        // (tag, index + 1) of the offered node, index + 1 == 0 means empty
+        std::atomic<uint64_t> word{0};
+    };
+
+    alignas(64) std::atomic<uint64_t> head{pack(0, NIL)};
+    alignas(64) std::atomic<uint64_t> freeList{pack(0, NIL)};
+    alignas(64) uint32_t cap;
+    node *nodes;
+    bool elimination = false;
+    std::atomic<uint64_t> eliminatedCount{0};
+    slot slots[ELIMINATION_SLOTS];
+
+    // Head word: high 32 bits tag, low 32 bits index. The tag wraps after 2^32 updates.
+    static uint64_t pack(uint32_t tag, uint32_t index) {
+        return (static_cast<uint64_t>(tag) << 32) | index;
     }
-    // Double rotate can be decomposed as two single rotates
-    void doubleRotateLeft(node *&ptr) {
-        rotateRight(ptr->left);
-        rotateLeft(ptr);
+    static uint32_t indexOf(uint64_t word) {
+        return static_cast<uint32_t>(word);
     }
-    void doubleRotateRight(node *&ptr) {
-        rotateLeft(ptr->right);
-        rotateRight(ptr);
+    static uint32_t tagOf(uint64_t word) {
+        return static_cast<uint32_t>(word >> 32);
+    }
+    static uint32_t randomSlot() {
+        static thread_local uint32_t s = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+        s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+        return s % ELIMINATION_SLOTS;
     }
 
-    // The only two private member variables
-    node *root = nullptr;
-    int bias = 1;
+    bool tryPushIndex(std::atomic<uint64_t> &list, uint32_t i) {
+        uint64_t old = list.load(std::memory_order_relaxed);
+        nodes[i].next.store(indexOf(old), std::memory_order_relaxed);
+        return list.compare_exchange_strong(old, pack(tagOf(old) + 1, i), std::memory_order_release, std::memory_order_relaxed);
+    }
+    void pushIndex(std::atomic<uint64_t> &list, uint32_t i) {
+        while (!tryPushIndex(list, i)) {}
+    }
+    uint32_t popIndex(std::atomic<uint64_t> &list) {
+        uint64_t old = list.load(std::memory_order_acquire);
+        while (indexOf(old) != NIL){
+            uint32_t next = nodes[indexOf(old)].next.load(std::memory_order_relaxed);
+            if (list.compare_exchange_weak(old, pack(tagOf(old) + 1, next), std::memory_order_acquire, std::memory_order_acquire))
+                return indexOf(old);
+        }
+        return NIL;
+    }
+
+    // Offer node i in a slot, return true if a pop took it.
+    bool eliminatePush(uint32_t i) {
+        slot &s = slots[randomSlot()];
+        uint64_t old = s.word.load(std::memory_order_relaxed);
+        if (indexOf(old) != 0) return false;
+        uint64_t offer = pack(tagOf(old) + 1, i + 1);
+        if (!s.word.compare_exchange_strong(old, offer, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return false;
+        for (unsigned k = 0; k < ELIMINATION_SPIN; ++k){
+            if (s.word.load(std::memory_order_acquire) != offer) return true;
+            cpuRelax();
+        }
+        // Withdraw the offer, failing means a pop has taken it
+        return !s.word.compare_exchange_strong(offer, pack(tagOf(offer) + 1, 0), std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+    // Take an offered node from a slot, return its index or NIL.
+    uint32_t eliminatePop() {
+        slot &s = slots[randomSlot()];
+        uint64_t old = s.word.load(std::memory_order_acquire);
+        if (indexOf(old) == 0) return NIL;
+        if (!s.word.compare_exchange_strong(old, pack(tagOf(old) + 1, 0), std::memory_order_acq_rel, std::memory_order_relaxed))
+            return NIL;
+        return indexOf(old) - 1;
+    }
 };
 
 //
-// Splay Tree:
-//  From top down splay. From bottom up method is another way of splay, which is much easier.
+// Mutex-protected myStack, the baseline of stackBenchmark.
 //
 template <typename T>
-class mySplayTree {
+class myLockedStack {
 public:
-    // default constructor
-    mySplayTree() = default;
-    // copy constructor
-    mySplayTree(const mySplayTree &rhs) {
-        root = clone(rhs.root);
-    }
-    mySplayTree(mySplayTree &&rhs){
-        root = rhs.root;
-    }
-    ~mySplayTree() {
-        clear(root);
+    bool try_push(const T &elem) {
+        std::lock_guard<std::mutex> lock(mtx);
+        stack.push(elem);
+        return true;
     }
-    bool empty() const {
-        return root == nullptr;
+    bool try_pop(T &out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stack.empty()) return false;
+        out = stack.top();
+        stack.pop();
+        return true;
     }
+private:
+    std::mutex mtx;
+    myStack<T> stack;
+};
 
-    void clear() {
-        clear(root);
-    }
+//
+//  Stack contention benchmark:
+//   1. Every thread alternates push and pop on one shared stack, so the stack stays small and the head is hot.
+//   2. Threads go 1, 2, 4, ... up to hardware_concurrency. Total operations stay config.operations for every thread count.
+//   3. Compares myLockFreeStack "Treiber", "Elimination" and mutex-protected myStack.
+//      eliminated is the fraction of operations completed in the elimination array.
+//
 
-    // Just splay and test the root value.
-    bool contain(const T &val){
-        if (root == nullptr) return false;
-        splay(val, root);
-        return root->value == val;
-    }
-    bool contain(T &&val){
-        // use left reference version instead, cause splay function receive left reference only.
-        return contain(val);
-    }
+// Configuration of stackBenchmark
+struct stackBenchConfig {
+    unsigned operations = 2000000;
+    unsigned capacity = 1 << 16;
+};
 
-    // Get the maximum and minimum value of splay tree
-    // After access the maximum or minimum value, a splay function should be applied.
-    T max(){
-        if (root == nullptr){
-            cerr << "Error: cannot get the maximum of empty tree." << endl;
-            return {};
+struct stackBenchResult {
+    string stack;
+    unsigned threads = 0;
+    unsigned operations = 0;
+    double seconds = 0;
+    double opsPerSec = 0;
+    double eliminated = 0;
+};
+
+template <typename stackType>
+stackBenchResult stackBenchRun(stackType &st, const string &name, unsigned threads, unsigned operations) {
+    stackBenchResult res;
+    res.stack = name;
+    res.threads = threads;
+    unsigned pairs = std::max(operations / threads / 2, 1u);
+    res.operations = pairs * 2 * threads;
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<uint64_t> checksum{0};
+    vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t)
+        pool.emplace_back([&, t]{
+            ++ready;
+            while (!go.load()) std::this_thread::yield();
+            uint64_t sum = 0, value;
+            for (unsigned i = 0; i < pairs; ++i){
+                st.try_push(static_cast<uint64_t>(t) * pairs + i);
+                if (st.try_pop(value)) sum += value;
+            }
+            checksum += sum;
+        });
+    while (ready.load() != threads) std::this_thread::yield();
+    auto begin = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto &th : pool) th.join();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    res.opsPerSec = res.operations / res.seconds;
+    return res;
+}
+
+vector<stackBenchResult> stackBenchmark(const stackBenchConfig &config = stackBenchConfig()) {
+    vector<stackBenchResult> results;
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    vector<unsigned> threads;
+    for (unsigned t = 1; t < cores; t *= 2)
+        threads.push_back(t);
+    threads.push_back(cores);
+    for (auto t : threads){
+        {
+            myLockFreeStack<uint64_t> st(config.capacity, "Treiber");
+            results.push_back(stackBenchRun(st, "Treiber", t, config.operations));
+        }
+        {
+            myLockFreeStack<uint64_t> st(config.capacity, "Elimination");
+            results.push_back(stackBenchRun(st, "Elimination", t, config.operations));
+            results.back().eliminated = st.eliminated() * 2.0 / results.back().operations;
+        }
+        {
+            myLockedStack<uint64_t> st;
+            results.push_back(stackBenchRun(st, "Mutex myStack", t, config.operations));
         }
-        node *maxNode = root;
-        while (maxNode->right != nullptr)
-            maxNode = maxNode->right;
-        splay(maxNode->value, root);
-        return maxNode->value;    
     }
-    T min(){
-        if (root == nullptr){
-            cerr << "Error: cannot get the minimum of empty tree." << endl;
-            return {};
+    return results;
+}
+
+void stackBenchReport(const vector<stackBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(16) << "stack" << std::right << std::setw(9) << "threads" << std::setw(12) << "operations"
+           << std::setw(14) << "ops/sec" << std::setw(12) << "eliminated" << endl;
+        for (auto &r : results)
+            os << std::left << std::setw(16) << r.stack << std::right << std::setw(9) << r.threads << std::setw(12) << r.operations
+               << std::setw(14) << static_cast<uint64_t>(r.opsPerSec) << std::setw(12) << r.eliminated << endl;
+    } else if (mode == "CSV"){
+        os << "stack,threads,operations,seconds,ops_per_sec,eliminated" << endl;
+        for (auto &r : results)
+            os << r.stack << "," << r.threads << "," << r.operations << "," << r.seconds << "," << r.opsPerSec << "," << r.eliminated << endl;
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"stack\": \"" << r.stack << "\", \"threads\": " << r.threads << ", \"operations\": "
+               << r.operations << ", \"seconds\": " << r.seconds << ", \"ops_per_sec\": " << r.opsPerSec
+               << ", \"eliminated\": " << r.eliminated << "}";
         }
-        node *minNode = root;
-        while (minNode->left != nullptr)
-            minNode = minNode->left;
-        splay(minNode->value, root);
-        return minNode->value;
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
     }
+}
 
-    // insert without recursion, top down way.
-    // using splay function instead.
-    void insert(const T &val) {
-        // create a new node.
-        node *newNode = new node{val, nullptr, nullptr};
-        if (root == nullptr){
-            root = newNode;
-            return;
+
+//
+// -------------------- Parallel --------------------
+//
+//  One work-stealing runtime shared by all parallel routines.
+//   1. myWorkStealingDeque is a Chase-Lev deque. The owner pushes and pops at the bottom, thieves steal from the top.
+//   2. myThreadPool has one deque per worker and an injection myMPMCQueue for tasks from other threads.
+//      Idle workers steal from random victims, then sleep until new work is submitted.
+//   3. myTaskGroup::fork() schedules a task, join() waits for all forked tasks and runs other tasks while waiting,
+//      so nested fork / join never blocks a worker.
+//   4. myParallelFor() splits an index range recursively on a task group.
+//   5. myThreadPool::instance() is the shared runtime, with hardware_concurrency - 1 workers (the joining thread helps).
+//
+
+//
+//  Chase-Lev work-stealing deque:
+//   1. push() and pop() are only called by the owner thread, steal() by any thread.
+//   2. The circular array grows by doubling. Old arrays are kept until destruction, since a thief may still read them.
+//   3. T should be trivially copyable, e.g. a task pointer.
+//
+template <typename T>
+class myWorkStealingDeque {
+public:
+    explicit myWorkStealingDeque(int64_t capacity = 256) {
+        int64_t size = 2;
+        while (size < capacity) size *= 2;
+        buffers.emplace_back(new buffer(size));
+        array.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+    myWorkStealingDeque(const myWorkStealingDeque &) = delete;
+    myWorkStealingDeque &operator=(const myWorkStealingDeque &) = delete;
+
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        buffer *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->size - 1)
+            a = grow(a, t, b);
+        a->put(b, item);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+    bool pop(T &item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        buffer *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b){
+            // Empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
         }
-        // splay val to see whether val already exists.
-        splay(val, root);
-        if (val < root->value){
-            newNode->left = root->left;
-            newNode->right = root;
-            root->left = nullptr;
-            root = newNode;
-        } else if (val > root->value) {
-            newNode->right = root->right;
-            newNode->left = root;
-            root->right = nullptr;
-            root = newNode;
-        } else{
-            // cerr << <"Error: inserted value already exists." << endl;
-            delete newNode;
+        item = a->get(b);
+        if (t == b){
+            // Last item, race with thieves
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
         }
+        return true;
     }
-    void insert(T &&val) {
-        // use left reference one. cause only left reference splay function are provided.
-        insert(val);
+    bool steal(T &item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        buffer *a = array.load(std::memory_order_acquire);
+        item = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
     }
-    
-    // remove without recursion, top down way
-    // use splay function instead.
-    void remove(const T& val) {
-        if (!contain(val)){
-            cerr << "Error: removed value dosen't exist." << endl;
-            return;
-        }
-        if (root->left == nullptr){
-            node *oldRoot = root;
-            root = root->right;
-            delete oldRoot;
-        } else {
-            // splay to move the maximum node of left tree to its root
-            splay(val, root->left);
-            root->left->right = root->right;
-            node *oldRoot = root;
-            root = root->left;
-            delete oldRoot;
-        }
+    // Approximate when other threads are running.
+    int64_t size() const {
+        return std::max<int64_t>(bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed), 0);
     }
-    void remove(T &&val) {
-        // use left reference version.
-        remove(val);
+    bool empty() const {
+        return size() == 0;
     }
 
 private:
-    // Inner node structure
-    struct node {
-        T value;
-        node *left;
-        node *right;
-        node(const T &val, node *l, node *r):
-            value(val), left(l), right(r) {}
-        node(T &&val, node *l, node *r):
-            value(std::move(val)), left(l),right(r) {}
+    struct buffer {
+        int64_t size;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+        explicit buffer(int64_t n): size(n), mask(n - 1), items(new std::atomic<T>[n]) {}
+        T get(int64_t i) const {
+            return items[i & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T item) {
+            items[i & mask].store(item, std::memory_order_relaxed);
+        }
     };
 
-    // The same as AVL tree. Recursive way.
-    node *clone(node *ptr) {
-        if (ptr == nullptr) return nullptr;
-        return new node{ptr->value, clone(ptr->left), clone(ptr->right)};
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<buffer *> array{nullptr};
+    // All arrays ever used, only touched by the owner
+    vector<std::unique_ptr<buffer>> buffers;
+
+    buffer *grow(buffer *a, int64_t t, int64_t b) {
+        buffer *bigger = new buffer(a->size * 2);
+        for (int64_t i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+        buffers.emplace_back(bigger);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
     }
+};
 
-    // The same as AVL tree. Recursive way.
-    void clear(node *&ptr) {
-        if (ptr == nullptr) return;
-        clear(ptr->left);
-        clear(ptr->right);
-        delete ptr;
-        ptr = nullptr;
+//
+// A unit of work of myThreadPool. pending is the counter of the owning task group, or nullptr.
+//
+struct myTask {
+    std::function<void()> func;
+    std::atomic<unsigned> *pending = nullptr;
+};
+
+//
+//  Work-stealing thread pool:
+//   1. A task submitted by a worker goes to the bottom of its own deque, other threads use the injection queue.
+//   2. A worker looks for work in order: own deque, injection queue, then steals from the other workers.
+//   3. An idle worker registers as sleeper and scans once more before it sleeps,
+//      submit() only takes the idle mutex when there is a sleeper.
+//
+class myThreadPool {
+public:
+    // threads == 0 means hardware_concurrency - 1 workers (at least 1)
+    explicit myThreadPool(unsigned threads = 0) {
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        for (unsigned i = 0; i < threads; ++i)
+            workers.emplace_back(new worker);
+        for (unsigned i = 0; i < threads; ++i)
+            workers[i]->thread = std::thread([this, i]{ workerLoop(i); });
+    }
+    myThreadPool(const myThreadPool &) = delete;
+    myThreadPool &operator=(const myThreadPool &) = delete;
+    // Tasks not started yet are dropped.
+    ~myThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            stop.store(true);
+        }
+        idleCond.notify_all();
+        for (auto &w : workers)
+            w->thread.join();
+        myTask *task;
+        for (auto &w : workers)
+            while (w->deque.pop(task)) delete task;
+        while (injection.try_pop(task)) delete task;
     }
 
-    // From top down splay
-    // make the node containing x at the root.
-    // if x is not found, make the last node at the root
-    // only left reference type is provided.
-    void splay(const T&x, node *&ptr) {
-        if (ptr == nullptr) return;
-        // header node contains left and right tree root.
-        // header is just a auxiliary node, who should be deleted at the end
-        node *header = new node{{}, nullptr, nullptr};
-        // leftMax and rightMin contain maximum node of left tree and minimum node of right tree
-        // initially, leftMax and rightMin set set to header.
-        node *leftMax = header, *rightMin = header;
-        while (true){
-            if (x < ptr->value){
-                if (ptr->left == nullptr) break;
-                // zig-zig case require a additional AVL single rotate (the same as AVL tree)
-                if (x < ptr->left->value && ptr->left->left != nullptr)
+    // The runtime shared by all parallel routines
+    static myThreadPool &instance() {
+        static myThreadPool pool;
+        return pool;
+    }
+
+    unsigned size() const {
+        return workers.size();
+    }
+
+    // Schedule a task, the pool deletes it after running.
+    void submit(myTask *task) {
+        workerSlot &slot = current();
+        if (slot.pool == this) workers[slot.index]->deque.push(task);
+        else injection.push(task);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0){
+            { std::lock_guard<std::mutex> lock(idleMutex); }
+            idleCond.notify_one();
+        }
+    }
+    // Fire and forget
+    template <typename Func>
+    void submit(Func &&func) {
+        submit(new myTask{std::function<void()>(std::forward<Func>(func)), nullptr});
+    }
+
+    // Find and run one task on the calling thread, return false if no task is found.
+    bool runOne() {
+        workerSlot &slot = current();
+        myTask *task = findTask(slot.pool == this ? static_cast<int>(slot.index) : -1);
+        if (task == nullptr) return false;
+        run(task);
+        return true;
+    }
+
+    // Statistics since construction or the last resetStats()
+    uint64_t steals() const {
+        uint64_t sum = 0;
+        for (auto &w : workers) sum += w->steals.load(std::memory_order_relaxed);
+        return sum + outsideSteals.load(std::memory_order_relaxed);
+    }
+    uint64_t executed() const {
+        uint64_t sum = 0;
+        for (auto &w : workers) sum += w->executed.load(std::memory_order_relaxed);
+        return sum + outsideExecuted.load(std::memory_order_relaxed);
+    }
+    void resetStats() {
+        for (auto &w : workers){
+            w->steals.store(0);
+            w->executed.store(0);
+        }
+        outsideSteals.store(0);
+        outsideExecuted.store(0);
+    }
+
+private:
+    struct alignas(64) worker {
+        myWorkStealingDeque<myTask *> deque;
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> executed{0};
+        uint32_t seed = 2463534242u;
+        std::thread thread;
+    };
+    // Pool and worker index of the calling thread
+    struct workerSlot {
+        myThreadPool *pool = nullptr;
+        unsigned index = 0;
+    };
+    // Failed rounds before an idle worker sleeps
+    static constexpr unsigned SPIN_LIMIT = 64;
+
+    vector<std::unique_ptr<worker>> workers;
+    myMPMCQueue<myTask *> injection{4096};
+    std::atomic<uint64_t> outsideSteals{0};
+    std::atomic<uint64_t> outsideExecuted{0};
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned> sleepers{0};
+    std::mutex idleMutex;
+    std::condition_variable idleCond;
+
+    static workerSlot &current() {
+        static thread_local workerSlot slot;
+        return slot;
+    }
+
+    // self is the worker index of the caller, -1 for other threads
+    myTask *findTask(int self) {
+        myTask *task = nullptr;
+        if (self >= 0 && workers[self]->deque.pop(task)) return task;
+        if (injection.try_pop(task)) return task;
+        unsigned n = workers.size();
+        if (n == 0) return nullptr;
+        uint32_t r;
+        if (self >= 0){
+            // xorshift of the worker
+            uint32_t &s = workers[self]->seed;
+            s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+            r = s;
+        } else {
+            r = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        }
+        for (unsigned k = 0; k < n; ++k){
+            unsigned victim = (r + k) % n;
+            if (static_cast<int>(victim) == self) continue;
+            if (workers[victim]->deque.steal(task)){
+                (self >= 0 ? workers[self]->steals : outsideSteals).fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void run(myTask *task) {
+        task->func();
+        workerSlot &slot = current();
+        (slot.pool == this ? workers[slot.index]->executed : outsideExecuted).fetch_add(1, std::memory_order_relaxed);
+        if (task->pending != nullptr)
+            task->pending->fetch_sub(1, std::memory_order_release);
+        delete task;
+    }
+
+    void workerLoop(unsigned index) {
+        current() = workerSlot{this, index};
+        workers[index]->seed += index * 2654435761u;
+        unsigned spin = 0;
+        while (!stop.load(std::memory_order_relaxed)){
+            myTask *task = findTask(index);
+            if (task != nullptr){
+                run(task);
+                spin = 0;
+                continue;
+            }
+            if (++spin < SPIN_LIMIT){
+                cpuRelax();
+                continue;
+            }
+            // Register as sleeper, then scan again so a concurrent submit() is not missed
+            std::unique_lock<std::mutex> lock(idleMutex);
+            sleepers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            task = findTask(index);
+            if (task == nullptr && !stop.load())
+                idleCond.wait_for(lock, std::chrono::milliseconds(10));
+            sleepers.fetch_sub(1);
+            lock.unlock();
+            if (task != nullptr) run(task);
+            spin = 0;
+        }
+    }
+};
+
+//
+//  Fork / join task group:
+//   1. fork() schedules func on the pool, join() returns when all forked tasks are finished.
+//   2. The joining thread runs other tasks while waiting. Tasks may fork into their own group.
+//   3. The destructor joins.
+//
+class myTaskGroup {
+public:
+    explicit myTaskGroup(myThreadPool &p = myThreadPool::instance()): pool(p) {}
+    myTaskGroup(const myTaskGroup &) = delete;
+    myTaskGroup &operator=(const myTaskGroup &) = delete;
+    ~myTaskGroup() {
+        join();
+    }
+    template <typename Func>
+    void fork(Func &&func) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.submit(new myTask{std::function<void()>(std::forward<Func>(func)), &pending});
+    }
+    void join() {
+        unsigned spin = 0;
+        while (pending.load(std::memory_order_acquire) != 0){
+            if (pool.runOne()){
+                spin = 0;
+            } else if (++spin < 64){
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+    myThreadPool &threadPool() {
+        return pool;
+    }
+private:
+    myThreadPool &pool;
+    std::atomic<unsigned> pending{0};
+};
+
+// Split [begin, end) in halves, fork the right halves and run the rest.
+template <typename Func>
+void parallelForRange(myTaskGroup &group, size_t begin, size_t end, size_t grain, const Func &func) {
+    while (end - begin > grain){
+        size_t mid = begin + (end - begin) / 2;
+        group.fork([&group, mid, end, grain, &func]{ parallelForRange(group, mid, end, grain, func); });
+        end = mid;
+    }
+    for (size_t i = begin; i < end; ++i)
+        func(i);
+}
+
+//
+// Call func(i) for i in [begin, end) in parallel.
+//  grain is the largest range run as one task, 0 means about 8 tasks per thread.
+//
+template <typename Func>
+void myParallelFor(size_t begin, size_t end, const Func &func, size_t grain = 0,
+                   myThreadPool &pool = myThreadPool::instance()) {
+    if (begin >= end) return;
+    if (grain == 0)
+        grain = std::max<size_t>((end - begin) / (8 * (pool.size() + 1)), 1);
+    myTaskGroup group(pool);
+    parallelForRange(group, begin, end, grain, func);
+    group.join();
+}
+
+//
+//  Scheduler overhead benchmark:
+//   1. "Serial"          - the same tiny tasks in a plain loop.
+//   2. "ParallelFor"     - myParallelFor with grain 1, one task per index.
+//   3. "ForkJoinTree"    - binary fork / join tree of the same number of leaves, like a recursive algorithm.
+//   4. Each case repeats config.repeats times. Time per task is the median run divided by the task count,
+//      steals per task show how much work moved between threads.
+//
+
+// Configuration of stealBenchmark
+struct stealBenchConfig {
+    unsigned tasks = 1 << 16;
+    unsigned taskWork = 100;        // loop iterations of one task
+    unsigned repeats = 5;
+};
+
+struct parallelBenchResult {
+    string name;
+    unsigned threads = 0;
+    unsigned tasks = 0;
+    pStats ns;                      // ns of the whole run
+    double nsPerTask = 0;
+    double stealsPerTask = 0;
+};
+
+// A tiny task of stealBenchmark, returns something so it is not optimized away.
+double stealBenchWork(unsigned work, size_t i) {
+    double x = static_cast<double>(i);
+    for (unsigned k = 0; k < work; ++k)
+        x = x * 0.999 + 1.0;
+    return x;
+}
+
+vector<parallelBenchResult> stealBenchmark(const stealBenchConfig &config = stealBenchConfig(),
+                                           myThreadPool &pool = myThreadPool::instance()) {
+    vector<parallelBenchResult> results;
+    vector<double> sink(config.tasks);
+    std::function<void(myTaskGroup &, size_t, size_t)> tree = [&](myTaskGroup &group, size_t begin, size_t end){
+        if (end - begin <= 1){
+            if (end > begin)
+                sink[begin] = stealBenchWork(config.taskWork, begin);
+            return;
+        }
+        size_t mid = begin + (end - begin) / 2;
+        myTaskGroup inner(group.threadPool());
+        inner.fork([&, begin, mid]{ tree(inner, begin, mid); });
+        tree(inner, mid, end);
+        inner.join();
+    };
+    vector<std::pair<string, std::function<void()>>> cases{
+        {"Serial", [&]{
+            for (size_t i = 0; i < config.tasks; ++i)
+                sink[i] = stealBenchWork(config.taskWork, i);
+        }},
+        {"ParallelFor", [&]{
+            myParallelFor(0, config.tasks, [&](size_t i){ sink[i] = stealBenchWork(config.taskWork, i); }, 1, pool);
+        }},
+        {"ForkJoinTree", [&]{
+            myTaskGroup group(pool);
+            tree(group, 0, config.tasks);
+        }},
+    };
+    for (auto &c : cases){
+        vector<double> ns;
+        uint64_t steals = 0;
+        for (unsigned r = 0; r < std::max(config.repeats, 1u); ++r){
+            pool.resetStats();
+            auto begin = std::chrono::steady_clock::now();
+            c.second();
+            ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+            steals += pool.steals();
+        }
+        parallelBenchResult res;
+        res.name = c.first;
+        res.threads = c.first == "Serial" ? 1 : pool.size() + 1;
+        res.tasks = config.tasks;
+        res.ns = pStats::of(ns);
+        res.nsPerTask = res.ns.median / std::max(config.tasks, 1u);
+        res.stealsPerTask = steals * 1.0 / ns.size() / std::max(config.tasks, 1u);
+        results.push_back(res);
+    }
+    return results;
+}
+
+void parallelBenchReport(const vector<parallelBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(16) << "case" << std::right << std::setw(9) << "threads" << std::setw(10) << "tasks"
+           << std::setw(14) << "median ms" << std::setw(12) << "ns/task" << std::setw(14) << "steals/task" << endl;
+        for (auto &r : results)
+            os << std::left << std::setw(16) << r.name << std::right << std::setw(9) << r.threads << std::setw(10) << r.tasks
+               << std::setw(14) << r.ns.median / 1e6 << std::setw(12) << r.nsPerTask << std::setw(14) << r.stealsPerTask << endl;
+    } else if (mode == "CSV"){
+        os << "case,threads,tasks,median_ns,p95_ns,ns_per_task,steals_per_task" << endl;
+        for (auto &r : results)
+            os << r.name << "," << r.threads << "," << r.tasks << "," << r.ns.median << "," << r.ns.p95
+               << "," << r.nsPerTask << "," << r.stealsPerTask << endl;
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"case\": \"" << r.name << "\", \"threads\": " << r.threads << ", \"tasks\": " << r.tasks
+               << ", \"median_ns\": " << r.ns.median << ", \"p95_ns\": " << r.ns.p95 << ", \"ns_per_task\": " << r.nsPerTask
+               << ", \"steals_per_task\": " << r.stealsPerTask << "}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
+}
+
+
+//
+// -------------------- Tree --------------------
+//
+
+//
+// Binary tree node structure
+//
+template <typename T>
+struct myBinaryTreeNode {
+    T value;
+    myBinaryTreeNode *left = nullptr;
+    myBinaryTreeNode *right = nullptr;
+    // Constructor
+    myBinaryTreeNode(const T &val): value(val){}
+    myBinaryTreeNode(T &&val): value(std::move(val)){}
+};
+
+//
+//  Expression tokenizer:
+//  1. Single pass over a std::string_view, tokens are views into the input, nothing is copied.
+//  2. Numbers are parsed with std::from_chars, names start with a letter or '_'.
+//  3. An operand glued to other operand characters (e.g. "2x", "1.2.3") is INVALID.
+//
+struct exprToken {
+    enum kind : uint8_t { NUMBER, NAME, OPERATOR, LEFT, RIGHT, END, INVALID };
+    kind type = END;
+    char op = 0;            // operator character of OPERATOR
+    double value = 0;       // value of NUMBER
+    std::string_view text;  // token text in the input
+};
+
+class exprTokenizer {
+public:
+    explicit exprTokenizer(std::string_view input): text(input){}
+
+    exprToken next() {
+        exprToken token;
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+        if (pos >= text.size()) return token;
+        const char *begin = text.data() + pos;
+        const char *last = text.data() + text.size();
+        const char *end = begin + 1;
+        char c = *begin;
+        if (isdigit(static_cast<unsigned char>(c)) || c == '.'){
+            auto result = std::from_chars(begin, last, token.value);
+            end = result.ptr;
+            token.type = result.ec == std::errc() ? exprToken::NUMBER : exprToken::INVALID;
+            if (end == begin) end = begin + 1;
+            while (end < last && isOperandChar(*end)){
+                token.type = exprToken::INVALID;
+                ++end;
+            }
+        } else if (isalpha(static_cast<unsigned char>(c)) || c == '_'){
+            while (end < last && (isalnum(static_cast<unsigned char>(*end)) || *end == '_')) ++end;
+            token.type = exprToken::NAME;
+        } else if (c == '+' || c == '-' || c == '*' || c == '/'){
+            token.type = exprToken::OPERATOR;
+            token.op = c;
+        } else if (c == '('){
+            token.type = exprToken::LEFT;
+        } else if (c == ')'){
+            token.type = exprToken::RIGHT;
+        } else {
+            token.type = exprToken::INVALID;
+        }
+        token.text = std::string_view(begin, end - begin);
+        pos = end - text.data();
+        return token;
+    }
+
+    // Binary operator priority, 0 for others
+    static unsigned priority(char op) {
+        switch (op){
+            case '+': case '-': return 1;
+            case '*': case '/': return 2;
+            default: return 0;
+        }
+    }
+
+private:
+    std::string_view text;
+    size_t pos = 0;
+
+    static bool isOperandChar(char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+};
+
+//
+//  Converter from infix to postfix expression
+//  1. Operands may be numbers or variable names (letters, digits and '_').
+//  2. A sign at the beginning or after '(' is read as 0 +/- operand.
+//  3. Tokens are separated by one space in the output, e.g. "a + 2 * b" becomes "a 2 b * +".
+//
+std::string infix2Postfix(std::string_view infix) {
+    // Operator stack, inline storage covers common expressions without allocation
+    myStack<char, 32> s;
+    string postfix;
+    postfix.reserve(infix.size() + infix.size() / 2 + 2);
+    auto emit = [&postfix](std::string_view token){
+        postfix.append(token.data(), token.size());
+        postfix.push_back(' ');
+    };
+    auto emitOperator = [&postfix](char op){
+        postfix.push_back(op);
+        postfix.push_back(' ');
+    };
+    exprTokenizer tokens(infix);
+    // Kind of the previous token, LEFT at the beginning
+    exprToken::kind previous = exprToken::LEFT;
+    for (exprToken token = tokens.next(); token.type != exprToken::END; token = tokens.next()){
+        switch (token.type){
+            case exprToken::NUMBER:
+            case exprToken::NAME:
+                if (previous != exprToken::LEFT && previous != exprToken::OPERATOR){
+                    cerr << "Error: missing operator before " << token.text << "." << endl;
+                    return {};
+                }
+                emit(token.text);
+                break;
+            case exprToken::LEFT:
+                if (previous != exprToken::LEFT && previous != exprToken::OPERATOR){
+                    cerr << "Error: missing operator before (." << endl;
+                    return {};
+                }
+                s.push('(');
+                break;
+            case exprToken::RIGHT:
+                while ( !s.empty() && s.top() != '(' ){
+                    emitOperator(s.top());
+                    s.pop();
+                }
+                if (s.empty()){
+                    cerr << "Error: unmatched ')'." << endl;
+                    return {};
+                }
+                s.pop();
+                break;
+            case exprToken::OPERATOR:
+                if (previous == exprToken::LEFT && (token.op == '+' || token.op == '-')){
+                    emit("0");
+                } else if (previous == exprToken::LEFT || previous == exprToken::OPERATOR){
+                    cerr << "Error: missing operand before " << token.op << "." << endl;
+                    return {};
+                }
+                while ( !s.empty() && s.top() != '(' && exprTokenizer::priority(s.top()) >= exprTokenizer::priority(token.op) ){
+                    emitOperator(s.top());
+                    s.pop();
+                }
+                s.push(token.op);
+                break;
+            default:
+                cerr << "Error: invalid token " << token.text << "." << endl;
+                return {};
+        }
+        previous = token.type;
+    }
+    while ( !s.empty() ){
+        if (s.top() == '('){
+            cerr << "Error: unmatched '('." << endl;
+            return {};
+        }
+        emitOperator(s.top());
+        s.pop();
+    }
+    if (!postfix.empty()) postfix.pop_back();
+    return postfix;
+}
+
+
+//
+//  Column kernels of expression batch evaluation:
+//   1. An operand is a column block or a constant (column == nullptr).
+//   2. batchKernel<Op>() computes out[i] = Op(a[i], b[i]) with AVX2 (4 doubles), SSE2 (2 doubles) or scalar code,
+//      chosen at compile time by __AVX2__ / __SSE2__ (e.g. build with -mavx2 or -march=native for AVX2).
+//
+struct batchOperand {
+    const double *column = nullptr;
+    double value = 0;
+};
+
+struct batchAdd {
+    static double scalar(double a, double b) { return a + b; }
+# if defined(__AVX2__)
+    static __m256d simd(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+# elif defined(__SSE2__)
+    static __m128d simd(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+# endif
+};
+struct batchSub {
+    static double scalar(double a, double b) { return a - b; }
+# if defined(__AVX2__)
+    static __m256d simd(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+# elif defined(__SSE2__)
+    static __m128d simd(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+# endif
+};
+struct batchMul {
+    static double scalar(double a, double b) { return a * b; }
+# if defined(__AVX2__)
+    static __m256d simd(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+# elif defined(__SSE2__)
+    static __m128d simd(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+# endif
+};
+struct batchDiv {
+    static double scalar(double a, double b) { return a / b; }
+# if defined(__AVX2__)
+    static __m256d simd(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+# elif defined(__SSE2__)
+    static __m128d simd(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+# endif
+};
+
+template <typename Op>
+void batchKernel(const batchOperand &a, const batchOperand &b, double *out, size_t n) {
+    size_t i = 0;
+# if defined(__AVX2__)
+    const __m256d ca = _mm256_set1_pd(a.value), cb = _mm256_set1_pd(b.value);
+    for (; i + 4 <= n; i += 4){
+        __m256d x = a.column ? _mm256_loadu_pd(a.column + i) : ca;
+        __m256d y = b.column ? _mm256_loadu_pd(b.column + i) : cb;
+        _mm256_storeu_pd(out + i, Op::simd(x, y));
+    }
+# elif defined(__SSE2__)
+    const __m128d ca = _mm_set1_pd(a.value), cb = _mm_set1_pd(b.value);
+    for (; i + 2 <= n; i += 2){
+        __m128d x = a.column ? _mm_loadu_pd(a.column + i) : ca;
+        __m128d y = b.column ? _mm_loadu_pd(b.column + i) : cb;
+        _mm_storeu_pd(out + i, Op::simd(x, y));
+    }
+# endif
+    for (; i < n; ++i)
+        out[i] = Op::scalar(a.column ? a.column[i] : a.value, b.column ? b.column[i] : b.value);
+}
+
+// Instruction set used by batchKernel
+string batchSimdLevel() {
+# if defined(__AVX2__)
+    return "AVX2";
+# elif defined(__SSE2__)
+    return "SSE2";
+# else
+    return "Scalar";
+# endif
+}
+
+
+//
+//  Expression bytecode:
+//   1. A compiled expression is a postfix tape of instructions. PUSH_CONST and PUSH_VAR push a constant
+//      or the value of a variable slot, ADD / SUB / MUL / DIV pop two values and push the result.
+//   2. Variables are numbered by first appearance. evaluate() takes their values as an array indexed by slot,
+//      slot(name) gives the slot of a name, so one program is evaluated many times with different values.
+//   3. evaluate() does no allocation and no string parsing. Division follows IEEE (x / 0 is inf or nan).
+//   4. evaluateBatch() evaluates whole columns: each instruction runs as a column kernel over blocks of rows,
+//      and the block size keeps the intermediate columns inside L1 cache.
+//   5. STORE copies the top value into a temporary without popping it, LOAD pushes a temporary.
+//      They let a shared subexpression be computed once per evaluation.
+//   6. Built by myExpressionTree::compile().
+//
+class myExpressionProgram {
+public:
+    enum opcode : uint8_t { PUSH_CONST, PUSH_VAR, ADD, SUB, MUL, DIV, STORE, LOAD };
+    struct instruction {
+        opcode op;
+        uint32_t arg = 0;   // index of constant, variable slot or temporary
+    };
+
+    // Evaluate with values[slot] as variable values
+    double evaluate(const double *values) const {
+        if (code.empty()){
+            cerr << "Error: cannot evaluate empty program." << endl;
+            return 0;
+        }
+        // Temporaries are stored after the stack
+        if (maxDepth + temps <= INLINE_DEPTH){
+            double stack[INLINE_DEPTH];
+            return run(values, stack, stack + maxDepth);
+        }
+        vector<double> stack(maxDepth + temps);
+        return run(values, stack.data(), stack.data() + maxDepth);
+    }
+    double evaluate(const vector<double> &values) const {
+        if (values.size() < names.size()){
+            cerr << "Error: expression needs " << names.size() << " variable values." << endl;
+            return 0;
+        }
+        return evaluate(values.data());
+    }
+
+    // Evaluate rows [0, rows), columns[slot] is the column of each variable, results go to out.
+    void evaluateBatch(const double *const *columns, double *out, size_t rows) const {
+        if (code.empty()){
+            cerr << "Error: cannot evaluate empty program." << endl;
+            return;
+        }
+        size_t block = batchBlock();
+        // Intermediate column of stack position i is buffer[i * block, (i + 1) * block)
+        vector<double> buffer(maxDepth * block);
+        vector<batchOperand> stack(maxDepth);
+        // A stored intermediate column is copied out of buffer, since its stack position is reused
+        vector<double> tempBuffer(temps * block);
+        vector<batchOperand> temp(temps);
+        const double *pool = constants.data();
+        for (size_t start = 0; start < rows; start += block){
+            size_t n = std::min(block, rows - start);
+            unsigned top = 0;
+            for (size_t k = 0; k < code.size(); ++k){
+                const instruction &ins = code[k];
+                if (ins.op == PUSH_CONST){
+                    stack[top++] = batchOperand{nullptr, pool[ins.arg]};
+                    continue;
+                }
+                if (ins.op == PUSH_VAR){
+                    stack[top++] = batchOperand{columns[ins.arg] + start, 0};
+                    continue;
+                }
+                if (ins.op == STORE){
+                    temp[ins.arg] = stack[top - 1];
+                    const double *column = temp[ins.arg].column;
+                    if (column >= buffer.data() && column < buffer.data() + buffer.size()){
+                        double *copy = tempBuffer.data() + ins.arg * block;
+                        std::memcpy(copy, column, n * sizeof(double));
+                        temp[ins.arg].column = copy;
+                    }
+                    continue;
+                }
+                if (ins.op == LOAD){
+                    stack[top++] = temp[ins.arg];
+                    continue;
+                }
+                batchOperand b = stack[--top];
+                batchOperand &a = stack[top - 1];
+                if (a.column == nullptr && b.column == nullptr){
+                    // Constant folding inside the block
+                    double x = a.value, y = b.value;
+                    a.value = ins.op == ADD ? x + y : ins.op == SUB ? x - y : ins.op == MUL ? x * y : x / y;
+                    continue;
+                }
+                // The last instruction writes into out directly
+                double *dst = k + 1 == code.size() ? out + start : buffer.data() + (top - 1) * block;
+                switch (ins.op){
+                    case ADD: batchKernel<batchAdd>(a, b, dst, n); break;
+                    case SUB: batchKernel<batchSub>(a, b, dst, n); break;
+                    case MUL: batchKernel<batchMul>(a, b, dst, n); break;
+                    case DIV: batchKernel<batchDiv>(a, b, dst, n); break;
+                    default: break;
+                }
+                a = batchOperand{dst, 0};
+            }
+            const batchOperand &result = stack[0];
+            if (result.column == nullptr)
+                std::fill(out + start, out + start + n, result.value);
+            else if (result.column != out + start)
+                std::memcpy(out + start, result.column, n * sizeof(double));
+        }
+    }
+    // Columns ordered by slot, every column should have the same number of rows.
+    vector<double> evaluateBatch(const vector<vector<double>> &columns) const {
+        if (columns.size() < names.size()){
+            cerr << "Error: expression needs " << names.size() << " columns." << endl;
+            return {};
+        }
+        size_t rows = columns.empty() ? 1 : columns[0].size();
+        vector<const double *> pointers;
+        for (unsigned i = 0; i < names.size(); ++i){
+            if (columns[i].size() != rows){
+                cerr << "Error: columns should have the same number of rows." << endl;
+                return {};
+            }
+            pointers.push_back(columns[i].data());
+        }
+        vector<double> out(rows);
+        evaluateBatch(pointers.data(), out.data(), rows);
+        return out;
+    }
+
+    // Slot of variable name, -1 if the expression does not use it
+    int slot(const string &name) const {
+        auto it = std::find(names.begin(), names.end(), name);
+        return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+    }
+    const vector<string> &variables() const {
+        return names;
+    }
+    unsigned variableCount() const {
+        return names.size();
+    }
+    const vector<instruction> &instructions() const {
+        return code;
+    }
+    const vector<double> &constantPool() const {
+        return constants;
+    }
+    // Largest stack depth during evaluation
+    unsigned depth() const {
+        return maxDepth;
+    }
+    unsigned tempCount() const {
+        return temps;
+    }
+    bool empty() const {
+        return code.empty();
+    }
+
+    // Print the tape, one instruction per line
+    void print(std::ostream &output = std::cout) const {
+        static const char *opName[] = {"PUSH_CONST", "PUSH_VAR", "ADD", "SUB", "MUL", "DIV", "STORE", "LOAD"};
+        for (auto &ins : code){
+            output << opName[ins.op];
+            if (ins.op == PUSH_CONST) output << " " << constants[ins.arg];
+            else if (ins.op == PUSH_VAR) output << " " << names[ins.arg];
+            else if (ins.op == STORE || ins.op == LOAD) output << " t" << ins.arg;
+            output << endl;
+        }
+    }
+
+    // Append instructions, used by compilers.
+    // pushOperator() returns false for unknown operator or less than two values on the stack.
+    void pushConstant(double value) {
+        constants.push_back(value);
+        emit(PUSH_CONST, constants.size() - 1);
+    }
+    void pushVariable(const string &name) {
+        int s = slot(name);
+        if (s < 0){
+            names.push_back(name);
+            s = names.size() - 1;
+        }
+        emit(PUSH_VAR, s);
+    }
+    bool pushOperator(char c) {
+        opcode op;
+        switch (c){
+            case '+': op = ADD; break;
+            case '-': op = SUB; break;
+            case '*': op = MUL; break;
+            case '/': op = DIV; break;
+            default:
+                cerr << "Error: unknown operator " << c << "." << endl;
+                return false;
+        }
+        if (curDepth < 2){
+            cerr << "Error: operator " << c << " needs two operands." << endl;
+            return false;
+        }
+        emit(op, 0);
+        return true;
+    }
+    // Store the top value into a new temporary, return its index
+    unsigned pushStore() {
+        emit(STORE, temps);
+        return temps++;
+    }
+    void pushLoad(unsigned temp) {
+        emit(LOAD, temp);
+    }
+
+private:
+    // Programs of at most this depth evaluate on a stack array
+    static constexpr unsigned INLINE_DEPTH = 64;
+    // Bytes of intermediate columns per block, about half of a 32KB L1 data cache
+    static constexpr size_t BATCH_BYTES = 16 * 1024;
+
+    vector<instruction> code;
+    vector<double> constants;
+    vector<string> names;
+    unsigned curDepth = 0;
+    unsigned maxDepth = 0;
+    unsigned temps = 0;
+
+    // Rows per block of evaluateBatch, multiple of 8 in [64, 2048]
+    size_t batchBlock() const {
+        size_t block = BATCH_BYTES / sizeof(double) / std::max(maxDepth, 1u);
+        block = std::min<size_t>(std::max<size_t>(block, 64), 2048);
+        return block / 8 * 8;
+    }
+
+    void emit(opcode op, uint32_t arg) {
+        code.push_back(instruction{op, arg});
+        if (op == PUSH_CONST || op == PUSH_VAR || op == LOAD)
+            maxDepth = std::max(maxDepth, ++curDepth);
+        else if (op != STORE)
+            --curDepth;
+    }
+
+    double run(const double *values, double *stack, double *temp) const {
+        double *top = stack;    // one past the top value
+        const double *pool = constants.data();
+        for (auto &ins : code){
+            switch (ins.op){
+                case PUSH_CONST: *top++ = pool[ins.arg]; break;
+                case PUSH_VAR:   *top++ = values[ins.arg]; break;
+                case ADD: --top; top[-1] += top[0]; break;
+                case SUB: --top; top[-1] -= top[0]; break;
+                case MUL: --top; top[-1] *= top[0]; break;
+                case DIV: --top; top[-1] /= top[0]; break;
+                case STORE: temp[ins.arg] = top[-1]; break;
+                case LOAD:  *top++ = temp[ins.arg]; break;
+            }
+        }
+        return top[-1];
+    }
+};
+
+
+//
+// Native code of a myExpressionProgram:
+//  1. x86-64 machine code with SSE2 double arithmetic (movsd, addsd, subsd, mulsd, divsd).
+//  2. Register allocation: stack position i lives in xmm<i>, temporary k in xmm<depth + k>,
+//     so only operands are loaded from memory. Used when depth + temporaries <= 16.
+//  3. Code is written into an mmap'd page, which is then switched to read + execute (never writable and executable).
+//  4. Called as double(const double *values, const double *constants), System V calling convention.
+//  5. Otherwise (not x86-64 Linux, too many registers, mmap / mprotect failed) evaluate() interprets the program.
+//     compiled() tells whether native code is used.
+//
+class myExpressionJit {
+public:
+    static constexpr unsigned REGISTERS = 16;
+
+    explicit myExpressionJit(myExpressionProgram prog): program(std::move(prog)) {
+        generate();
+    }
+    myExpressionJit(const myExpressionJit &) = delete;
+    myExpressionJit &operator=(const myExpressionJit &) = delete;
+    myExpressionJit(myExpressionJit &&rhs) noexcept: program(std::move(rhs.program)) {
+        std::swap(memory, rhs.memory);
+        std::swap(mapped, rhs.mapped);
+        std::swap(bytes, rhs.bytes);
+        std::swap(entry, rhs.entry);
+    }
+    myExpressionJit &operator=(myExpressionJit &&rhs) noexcept {
+        if (this != &rhs){
+            release();
+            program = std::move(rhs.program);
+            std::swap(memory, rhs.memory);
+            std::swap(mapped, rhs.mapped);
+            std::swap(bytes, rhs.bytes);
+            std::swap(entry, rhs.entry);
+        }
+        return *this;
+    }
+    ~myExpressionJit(){
+        release();
+    }
+
+    // values are indexed by program slots, as in myExpressionProgram::evaluate()
+    double evaluate(const double *values) const {
+        if (entry != nullptr)
+            return entry(values, program.constantPool().data());
+        return program.evaluate(values);
+    }
+    double evaluate(const vector<double> &values) const {
+        if (values.size() < program.variableCount()){
+            cerr << "Error: expression needs " << program.variableCount() << " values." << endl;
+            return 0;
+        }
+        return evaluate(values.data());
+    }
+
+    bool compiled() const {
+        return entry != nullptr;
+    }
+    // Bytes of machine code, 0 when interpreted
+    size_t codeSize() const {
+        return bytes;
+    }
+    const myExpressionProgram &bytecode() const {
+        return program;
+    }
+
+private:
+    using function = double (*)(const double *, const double *);
+    myExpressionProgram program;
+    void *memory = nullptr;
+    size_t mapped = 0;
+    size_t bytes = 0;
+    function entry = nullptr;
+
+    void generate() {
+# if defined(__x86_64__) && defined(__linux__)
+        if (program.empty() || program.depth() + program.tempCount() > REGISTERS) return;
+        using op = myExpressionProgram::opcode;
+        const unsigned RSI = 6, RDI = 7;
+        vector<uint8_t> code;
+        unsigned top = 0;
+        for (auto &ins : program.instructions()){
+            switch (ins.op){
+                case op::PUSH_CONST: load(code, top++, RSI, ins.arg * sizeof(double)); break;
+                case op::PUSH_VAR:   load(code, top++, RDI, ins.arg * sizeof(double)); break;
+                case op::ADD: --top; arith(code, 0x58, top - 1, top); break;
+                case op::SUB: --top; arith(code, 0x5C, top - 1, top); break;
+                case op::MUL: --top; arith(code, 0x59, top - 1, top); break;
+                case op::DIV: --top; arith(code, 0x5E, top - 1, top); break;
+                case op::STORE: move(code, program.depth() + ins.arg, top - 1); break;
+                case op::LOAD:  move(code, top++, program.depth() + ins.arg); break;
+            }
+        }
+        // Result is in xmm0
+        code.push_back(0xC3);   // ret
+
+        long page = sysconf(_SC_PAGESIZE);
+        if (page <= 0) return;
+        size_t length = (code.size() + page - 1) / page * page;
+        void *ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return;
+        std::memcpy(ptr, code.data(), code.size());
+        if (mprotect(ptr, length, PROT_READ | PROT_EXEC) != 0){
+            munmap(ptr, length);
+            return;
+        }
+        memory = ptr;
+        mapped = length;
+        bytes = code.size();
+        entry = reinterpret_cast<function>(ptr);
+# endif
+    }
+
+    void release() {
+# if defined(__x86_64__) && defined(__linux__)
+        if (memory != nullptr) munmap(memory, mapped);
+# endif
+        memory = nullptr;
+        mapped = 0;
+        bytes = 0;
+        entry = nullptr;
+    }
+
+    // REX prefix for xmm registers 8 ~ 15, r extends ModRM.reg and b extends ModRM.rm
+    static void rex(vector<uint8_t> &code, unsigned r, unsigned b) {
+        uint8_t prefix = 0x40 | ((r >> 3) << 2) | (b >> 3);
+        if (prefix != 0x40) code.push_back(prefix);
+    }
+    // movsd xmm<reg>, [base + disp32]
+    static void load(vector<uint8_t> &code, unsigned reg, unsigned base, uint32_t disp) {
+        code.push_back(0xF2);
+        rex(code, reg, 0);
+        code.push_back(0x0F);
+        code.push_back(0x10);
+        code.push_back(0x80 | ((reg & 7) << 3) | base);
+        for (int i = 0; i < 4; ++i)
+            code.push_back((disp >> (8 * i)) & 0xFF);
+    }
+    // addsd / subsd / mulsd / divsd xmm<dst>, xmm<src>
+    static void arith(vector<uint8_t> &code, uint8_t opcode, unsigned dst, unsigned src) {
+        code.push_back(0xF2);
+        rex(code, dst, src);
+        code.push_back(0x0F);
+        code.push_back(opcode);
+        code.push_back(0xC0 | ((dst & 7) << 3) | (src & 7));
+    }
+    // movapd xmm<dst>, xmm<src>
+    static void move(vector<uint8_t> &code, unsigned dst, unsigned src) {
+        if (dst == src) return;
+        code.push_back(0x66);
+        rex(code, dst, src);
+        code.push_back(0x0F);
+        code.push_back(0x28);
+        code.push_back(0xC0 | ((dst & 7) << 3) | (src & 7));
+    }
+};
+
+
+//
+//  Expression Tree Implementation:
+//  1. Nodes live in one arena array with 32-bit child indices, node text is a slice of one text pool,
+//     so building an expression costs two allocations and clearing it frees two blocks.
+//  2. The arena is kept in post-order: children always come before their parent and root is the last node.
+//     Evaluation is a loop over the arena, printing and compiling use an explicit stack, nothing recurses.
+//  3. Expression public routines include three expression notation: prefix, infix, postfix
+//  4. By now, only support binary operators: +, -, *, /
+//  5. Operands are numbers or variable names, compile() turns the tree into a myExpressionProgram.
+//  6. optimize() folds constants and shares identical subtrees, after which the tree is a DAG.
+//
+class myExpressionTree{
+public:
+    // Build the tree from postfix tokens (see exprTokenizer).
+    // A first pass counts nodes and text, so the arena and the text pool are allocated once.
+    void readPostfix(std::string_view postfix) {
+        clear();
+        size_t count = 0, textSize = OPERATORS.size();
+        exprTokenizer counter(postfix);
+        for (exprToken token = counter.next(); token.type != exprToken::END; token = counter.next()){
+            ++count;
+            if (token.type != exprToken::OPERATOR) textSize += token.text.size();
+        }
+        nodes.reserve(count);
+        pool.reserve(textSize);
+        pool.append(OPERATORS.data(), OPERATORS.size());
+
+        myStack<uint32_t, 32> s;
+        exprTokenizer tokens(postfix);
+        for (exprToken token = tokens.next(); token.type != exprToken::END; token = tokens.next()){
+            if (token.type == exprToken::NUMBER || token.type == exprToken::NAME){
+                s.push(addLeaf(token.text));
+            } else if (token.type == exprToken::OPERATOR && s.size() >= 2){
+                uint32_t right = s.top(); s.pop();
+                uint32_t left = s.top(); s.pop();
+                s.push(addOperator(token.op, left, right));
+            } else {
+                cerr << "Error: Invalid postfix expression." << endl;
+                clear();
+                return;
+            }
+        }
+        if (s.size() != 1){
+            if (!s.empty()) cerr << "Error: Invalid postfix expression." << endl;
+            clear();
+            return;
+        }
+        root = s.top();
+    }
+    // Use infix2Postfix to convert infix to postfix, then read postfix
+    void readInfix(std::string_view infix) {
+        std::string postfix = infix2Postfix(infix);
+        readPostfix(postfix);
+    }
+
+    // Compile into a bytecode program. Numeric operands become constants, others become variables.
+    // A shared operator node is compiled at its first use and stored, later uses load the temporary.
+    myExpressionProgram compile() const {
+        myExpressionProgram program;
+        if (root == NIL){
+            cerr << "Error: cannot compile empty expression tree." << endl;
+            return program;
+        }
+        // Number of parents of every node, a node with more than one is shared
+        vector<uint32_t> parents(nodes.size(), 0);
+        for (auto &n : nodes){
+            if (n.left == NIL) continue;
+            ++parents[n.left];
+            ++parents[n.right];
+        }
+        vector<uint32_t> temps(nodes.size(), NIL);
+        // Post-order traversal, expanded is true when children have been pushed
+        vector<std::pair<uint32_t, bool>> stack{{root, false}};
+        while (!stack.empty()){
+            auto [i, expanded] = stack.back();
+            stack.pop_back();
+            const node &n = nodes[i];
+            if (n.left == NIL){
+                double value;
+                if (isNumber(text(i), value)) program.pushConstant(value);
+                else program.pushVariable(string(text(i)));
+            } else if (temps[i] != NIL){
+                program.pushLoad(temps[i]);
+            } else if (!expanded){
+                stack.push_back({i, true});
+                stack.push_back({n.right, false});
+                stack.push_back({n.left, false});
+            } else {
+                program.pushOperator(pool[n.offset]);
+                if (parents[i] > 1)
+                    temps[i] = program.pushStore();
+            }
+        }
+        return program;
+    }
+
+    // Compile into native code, interpreted if native code is not available (see myExpressionJit)
+    myExpressionJit compileNative() const {
+        return myExpressionJit(compile());
+    }
+
+    // Evaluation over the arena, variables are looked up by name
+    double evaluate(const std::map<string, double> &variables) const {
+        if (root == NIL){
+            cerr << "Error: cannot evaluate empty expression tree." << endl;
+            return 0;
+        }
+        vector<double> values(nodes.size());
+        for (uint32_t i = 0; i < nodes.size(); ++i){
+            const node &n = nodes[i];
+            if (n.left == NIL){
+                if (isNumber(text(i), values[i])) continue;
+                auto it = variables.find(string(text(i)));
+                if (it == variables.end()){
+                    cerr << "Error: no value for variable " << text(i) << "." << endl;
+                    return 0;
+                }
+                values[i] = it->second;
+                continue;
+            }
+            double a = values[n.left], b = values[n.right];
+            switch (pool[n.offset]){
+                case '+': values[i] = a + b; break;
+                case '-': values[i] = a - b; break;
+                case '*': values[i] = a * b; break;
+                default:  values[i] = a / b; break;
+            }
+        }
+        return values[root];
+    }
+
+    //
+    // Optimize the expression, return the number of eliminated nodes.
+    //  1. Constant subtrees are folded into one number (unless the result is inf or nan).
+    //  2. Identities: x*1, 1*x, x/1, x+0, 0+x, x-0 become x. x*0 and 0*x become 0.
+    //  3. Identical subtrees are hash-consed into one node, so the tree becomes a DAG.
+    //     compile() computes every shared subtree once and reuses it through a temporary.
+    //  One pass in arena order does all three, since children are final before their parent is visited.
+    //  The arena is compacted afterwards.
+    //
+    unsigned optimize() {
+        if (root == NIL) return 0;
+        uint32_t before = nodes.size();
+        // canonical[i] is the node which replaces node i
+        vector<uint32_t> canonical(before);
+        std::map<std::tuple<string, uint32_t, uint32_t>, uint32_t> table;
+        auto share = [&](uint32_t i){
+            auto key = std::make_tuple(string(text(i)), nodes[i].left, nodes[i].right);
+            auto found = table.find(key);
+            return found == table.end() ? (table[key] = i) : found->second;
+        };
+        for (uint32_t i = 0; i < before; ++i){
+            if (nodes[i].left != NIL){
+                nodes[i].left = canonical[nodes[i].left];
+                nodes[i].right = canonical[nodes[i].right];
+            }
+            canonical[i] = share(fold(i));
+        }
+        root = canonical[root];
+        compact();
+        return before - nodes.size();
+    }
+
+    // Number of distinct nodes, shared nodes are counted once
+    unsigned nodeCount() const {
+        return nodes.size();
+    }
+
+    // Return three types of expression
+    void printInfix(std::ostream &output = std::cout) const {
+        print(output, INFIX);
+    }
+    void printPostfix(std::ostream &output = std::cout) const {
+        print(output, POSTFIX);
+    }
+    void printPrefix(std::ostream &output = std::cout) const {
+        print(output, PREFIX);
+    }
+
+    // clear() and empty()
+    void clear() {
+        nodes.clear();
+        nodes.shrink_to_fit();
+        pool.clear();
+        pool.shrink_to_fit();
+        root = NIL;
+    }
+    bool empty() const {
+        return root == NIL;
+    }
+
+private:
+    static constexpr uint32_t NIL = 0xffffffff;
+    // Operator text is shared, operator nodes point into the head of the pool
+    static constexpr std::string_view OPERATORS = "+-*/";
+    enum order { PREFIX, INFIX, POSTFIX };
+
+    // Arena node, left and right are NIL for a leaf
+    struct node {
+        uint32_t left = NIL;
+        uint32_t right = NIL;
+        uint32_t offset = 0;    // text in pool
+        uint32_t length = 0;
+    };
+    vector<node> nodes;
+    string pool;
+    uint32_t root = NIL;
+
+    std::string_view text(uint32_t i) const {
+        return std::string_view(pool.data() + nodes[i].offset, nodes[i].length);
+    }
+    uint32_t addLeaf(std::string_view value) {
+        nodes.push_back(node{NIL, NIL, static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(value.size())});
+        pool.append(value.data(), value.size());
+        return nodes.size() - 1;
+    }
+    uint32_t addOperator(char op, uint32_t left, uint32_t right) {
+        nodes.push_back(node{left, right, static_cast<uint32_t>(OPERATORS.find(op)), 1});
+        return nodes.size() - 1;
+    }
+
+    // Iterative traversal, stage counts the children already visited
+    void print(std::ostream &output, order mode) const {
+        if (root == NIL) return;
+        vector<std::pair<uint32_t, uint8_t>> stack{{root, 0}};
+        while (!stack.empty()){
+            auto &[i, stage] = stack.back();
+            const node &n = nodes[i];
+            if (n.left == NIL){
+                output << text(i) << " ";
+                stack.pop_back();
+                continue;
+            }
+            if (stage == mode) output << text(i) << " ";
+            if (stage == 2){
+                stack.pop_back();
+                continue;
+            }
+            uint32_t child = stage++ == 0 ? n.left : n.right;
+            stack.push_back({child, 0});    // invalidates i and stage
+        }
+    }
+
+    // Whether a leaf string is a number, e.g. "2", "-0.5", ".5e3"
+    static bool isNumber(std::string_view value, double &number) {
+        if (value.empty()) return false;
+        size_t first = value[0] == '-' ? 1 : 0;
+        if (first >= value.size() || (!isdigit(static_cast<unsigned char>(value[first])) && value[first] != '.')) return false;
+        auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+        return result.ec == std::errc() && result.ptr == value.data() + value.size();
+    }
+    // Shortest text that reads back as the same double
+    static string formatNumber(double value) {
+        char text[32];
+        for (int precision = 15; precision <= 17; ++precision){
+            std::snprintf(text, sizeof(text), "%.*g", precision, value);
+            if (std::strtod(text, nullptr) == value) break;
+        }
+        return text;
+    }
+
+    // Constant folding and identities of node i, whose children are already final.
+    // Return the replacement of i, which may be a new leaf at the end of the arena.
+    uint32_t fold(uint32_t i) {
+        const node n = nodes[i];
+        if (n.left == NIL) return i;
+        double a = 0, b = 0;
+        bool ca = nodes[n.left].left == NIL && isNumber(text(n.left), a);
+        bool cb = nodes[n.right].left == NIL && isNumber(text(n.right), b);
+        char op = pool[n.offset];
+        if (ca && cb){
+            double v = op == '+' ? a + b : op == '-' ? a - b : op == '*' ? a * b : a / b;
+            if (std::isfinite(v)) return addLeaf(formatNumber(v));
+        } else if (op == '*'){
+            if ((ca && a == 0) || (cb && b == 0)) return addLeaf("0");
+            if (ca && a == 1) return n.right;
+            if (cb && b == 1) return n.left;
+        } else if (op == '+'){
+            if (ca && a == 0) return n.right;
+            if (cb && b == 0) return n.left;
+        } else if (op == '-' || op == '/'){
+            if (cb && b == (op == '-' ? 0 : 1)) return n.left;
+        }
+        return i;
+    }
+
+    // Rebuild the arena with the nodes reachable from root in post-order, drop unused text
+    void compact() {
+        vector<uint32_t> remap(nodes.size(), NIL);
+        vector<node> arena;
+        arena.reserve(nodes.size());
+        string text;
+        text.reserve(pool.size());
+        text.append(OPERATORS.data(), OPERATORS.size());
+        vector<std::pair<uint32_t, bool>> stack{{root, false}};
+        while (!stack.empty()){
+            auto [i, expanded] = stack.back();
+            stack.pop_back();
+            if (remap[i] != NIL) continue;
+            node n = nodes[i];
+            if (n.left != NIL && !expanded){
+                stack.push_back({i, true});
+                stack.push_back({n.right, false});
+                stack.push_back({n.left, false});
+                continue;
+            }
+            if (n.left == NIL){
+                uint32_t offset = text.size();
+                text.append(pool, n.offset, n.length);
+                n.offset = offset;
+            } else {
+                n.left = remap[n.left];
+                n.right = remap[n.right];
+            }
+            remap[i] = arena.size();
+            arena.push_back(n);
+        }
+        root = remap[root];
+        nodes.swap(arena);
+        pool.swap(text);
+    }
+};
+
+//
+//  Expression evaluation benchmark:
+//  1. TreeWalk (myExpressionTree::evaluate), Bytecode (myExpressionProgram::evaluate) and JIT (myExpressionJit::evaluate)
+//     evaluate the same expression over config.rows random variable rows, cycled config.evaluations times.
+//  2. Median of config.repeats runs. Checksums of the cases are compared, any difference is reported.
+//
+struct exprBenchConfig {
+    unsigned evaluations = 1000000;
+    unsigned rows = 1024;
+    unsigned repeats = 5;
+};
+
+struct exprBenchResult {
+    string name;
+    unsigned evaluations = 0;
+    pStats ns;
+    double nsPerEval = 0;
+    double checksum = 0;
+};
+
+vector<exprBenchResult> exprBenchmark(const string &infix = "(a+b)*(a-b)/(c+1.5)+a*c-2*b",
+                                      const exprBenchConfig &config = exprBenchConfig()) {
+    vector<exprBenchResult> results;
+    myExpressionTree tree;
+    tree.readInfix(infix);
+    if (tree.empty()) return results;
+    myExpressionProgram program = tree.compile();
+    myExpressionJit jit = tree.compileNative();
+    unsigned rows = std::max(config.rows, 1u);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(1, 2);
+    vector<double> values(rows * program.variableCount());
+    vector<std::map<string, double>> named(rows);
+    for (unsigned r = 0; r < rows; ++r)
+        for (unsigned v = 0; v < program.variableCount(); ++v)
+            named[r][program.variables()[v]] = values[r * program.variableCount() + v] = dist(rng);
+    const double *data = values.data();
+    size_t stride = program.variableCount();
+    vector<std::pair<string, std::function<double(unsigned)>>> cases{
+        {"TreeWalk", [&](unsigned r){ return tree.evaluate(named[r]); }},
+        {"Bytecode", [&](unsigned r){ return program.evaluate(data + r * stride); }},
+        {jit.compiled() ? "JIT" : "JIT (interpreted)", [&](unsigned r){ return jit.evaluate(data + r * stride); }},
+    };
+    for (auto &c : cases){
+        vector<double> ns;
+        double sum = 0;
+        for (unsigned rep = 0; rep < std::max(config.repeats, 1u); ++rep){
+            sum = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (unsigned i = 0, r = 0; i < config.evaluations; ++i){
+                sum += c.second(r);
+                if (++r == rows) r = 0;
+            }
+            ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+        }
+        exprBenchResult res;
+        res.name = c.first;
+        res.evaluations = config.evaluations;
+        res.ns = pStats::of(ns);
+        res.nsPerEval = res.ns.median / std::max(config.evaluations, 1u);
+        res.checksum = sum;
+        if (!results.empty() && res.checksum != results.front().checksum)
+            cerr << "Error: " << res.name << " checksum " << res.checksum << " differs from " << results.front().checksum << "." << endl;
+        results.push_back(res);
+    }
+    return results;
+}
+
+void exprBenchReport(const vector<exprBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(20) << "case" << std::right << std::setw(12) << "evaluations"
+           << std::setw(14) << "median ms" << std::setw(12) << "ns/eval" << std::setw(16) << "checksum" << endl;
+        for (auto &r : results)
+            os << std::left << std::setw(20) << r.name << std::right << std::setw(12) << r.evaluations
+               << std::setw(14) << r.ns.median / 1e6 << std::setw(12) << r.nsPerEval << std::setw(16) << r.checksum << endl;
+    } else if (mode == "CSV"){
+        os << "case,evaluations,median_ns,p95_ns,ns_per_eval,checksum" << endl;
+        for (auto &r : results)
+            os << r.name << "," << r.evaluations << "," << r.ns.median << "," << r.ns.p95 << "," << r.nsPerEval << "," << r.checksum << endl;
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"case\": \"" << r.name << "\", \"evaluations\": " << r.evaluations
+               << ", \"median_ns\": " << r.ns.median << ", \"p95_ns\": " << r.ns.p95 << ", \"ns_per_eval\": " << r.nsPerEval
+               << ", \"checksum\": " << r.checksum << "}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
+}
+
+
+//
+//  In-order traversal of a binary tree with an explicit stack, so deep trees do not overflow the call stack.
+//  Node needs value, left and right. Used by forEach() of myBST, myAVLTree and mySplayTree.
+//
+template <typename Node, typename Func>
+void inOrderVisit(const Node *root, const Func &func) {
+    vector<const Node *> stack;
+    const Node *ptr = root;
+    while (ptr != nullptr || !stack.empty()){
+        for (; ptr != nullptr; ptr = ptr->left)
+            stack.push_back(ptr);
+        ptr = stack.back();
+        stack.pop_back();
+        func(ptr->value);
+        ptr = ptr->right;
+    }
+}
+
+//
+//  Binary Search Tree (BST):
+//  node->values repeat is not allowed
+//
+template <typename T>
+class myBST{
+public:
+    // Constructors
+    myBST() = default;
+    // Copy constructor
+    myBST(const myBST<T> &rhs){
+        root = clone(rhs.root);
+    }
+    // Move constructor
+    myBST(myBST<T> &&rhs){
+        root = rhs.root;
+        stats = rhs.stats;
+        rhs.root = nullptr;
+        rhs.stats = myAllocStats();
+    }
+    // Destructor
+    ~myBST(){
+        clear(root);
+    }
+
+    // Get the minimum and maximum value
+    T min() const {
+        return min(root);
+    }
+    T max() const {
+        return max(root);
+    }
+    // Whether contain val
+    bool contain(T val) const {
+        PTIME_SCOPE("myBST::contain");
+        return contain(root, val);
+    }
+    // empty and clear
+    bool empty() const {
+        return root == nullptr;
+    }
+    void clear() {
+        clear(root);
+    }
+    // Allocation statistics, one live block per element.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
+
+    // insert and remove
+    void insert(const T &val) {
+        PTIME_SCOPE("myBST::insert");
+        insert(root, val);
+    }
+    void insert(T &&val){
+        PTIME_SCOPE("myBST::insert");
+        insert(root, std::move(val));
+    }
+    void remove(const T &val){
+        PTIME_SCOPE("myBST::remove");
+        remove(root, val);
+    }
+    void remove(T &&val){
+        PTIME_SCOPE("myBST::remove");
+        // Remove a right reference is of no profit
+        // So I just use left reference again
+        remove(root, val);
+    }
+
+    // Visit values in ascending order, see inOrderVisit()
+    template <typename Func>
+    void forEach(const Func &func) const {
+        inOrderVisit(root, func);
+    }
+
+private:
+    // Inner node structure
+    struct node{
+        T value;
+        node *left = nullptr;
+        node *right = nullptr;
+
+        // Constructors
+        node() = default;
+        node(const T &val, node *l, node *r):
+            value(val), left(l), right(r){}
+        node(T &&val, node *l, node *r):
+            value(std::move(val)), left(l), right(r){}
+    };
+    
+    node *root = nullptr;
+    myAllocStats stats;
+
+    // All nodes are created and destroyed here, so they can be counted.
+    template <typename... Args>
+    node *newNode(Args &&...args) {
+        stats.onAlloc(sizeof(node));
+        return new node{std::forward<Args>(args)...};
+    }
+    void deleteNode(node *ptr) {
+        stats.onFree(sizeof(node));
+        delete ptr;
+    }
+
+    // Return a clone of the tree pointed by ptr
+    node *clone(node *ptr){
+        if (ptr == nullptr) return nullptr;
+        return newNode(ptr->value, clone(ptr->left), clone(ptr->right));
+    }
+    // Private versions of all routines
+    // The minimum is the left most node and the maximum is the right most node.
+    T min(node *ptr) const {
+        if (ptr == nullptr) {
+            cerr << "Error: cannot get min value of nullptr" << endl;
+            return {};
+        }
+        while (ptr->left != nullptr)
+            ptr = ptr->left;
+        return ptr->value;
+    }
+    T max(node *ptr) const {
+        if (ptr == nullptr) {
+            cerr << "Error: cannot get max value of nullptr" << endl;
+            return {};
+        }
+        while (ptr->right != nullptr)
+            ptr = ptr->right;
+        return ptr->value;
+    }
+    // Follow the search order instead of visiting every node.
+    bool contain(node *ptr, const T &val) const {
+        while (ptr != nullptr){
+            if (val < ptr->value) ptr = ptr->left;
+            else if (ptr->value < val) ptr = ptr->right;
+            else return true;
+        }
+        return false;
+    }
+    void clear(node *&ptr){
+        if (ptr == nullptr) return;
+        clear(ptr->left);
+        clear(ptr->right);
+        deleteNode(ptr);
+        ptr = nullptr;
+    }
+
+    // Real insert routine
+    void insert(node *&ptr, const T &val){
+        if (ptr == nullptr){
+            ptr = newNode(val, nullptr, nullptr);
+        } else if (ptr->value > val){
+            insert(ptr->left, val);
+        } else if (ptr->value < val){
+            insert(ptr->right, val);
+        } else {
+            // cerr << "Error: inserted value already exist." <<  endl;
+        }
+    }
+    void insert(node *&ptr, T &&val){
+        if (ptr == nullptr){
+            ptr = newNode(std::move(val), nullptr, nullptr);
+        } else if (ptr->value > val){
+            insert(ptr->left, std::move(val));
+        } else if (ptr->value < val){
+            insert(ptr->right, std::move(val));
+        } else {
+            // cerr << "Error: inserted value already exist." <<  endl;
+        }
+    }
+
+    // Real remove routine
+    void remove(node *&ptr, const T &val){
+        if (ptr == nullptr){
+            // cerr << "Error: removed value dosen't exist." << endl;
+            return;
+        }
+        if (ptr->value > val) remove(ptr->left, val);
+        else if (ptr->value < val) remove(ptr->right, val);
+        else {
+            // For leaf nodes
+            if (ptr->left == nullptr && ptr->right == nullptr){
+                deleteNode(ptr);
+                ptr = nullptr;
+            } else if (ptr->left == nullptr){
+                // For nodes with only one child at right branch
+                auto p = ptr;
+                ptr = ptr->right;
+                deleteNode(p);
+            } else if (ptr->right == nullptr){
+                // For nodes with only one child at left branch
+                auto p = ptr;
+                ptr = ptr->left;
+                deleteNode(p);
+            } else {
+                // For nodes with two children, find the max of right child,
+                // and move the max value to the node, recursively remove the max node.
+                auto rightMin = min(ptr->right);
+                ptr->value = rightMin;
+                remove(ptr->right, rightMin);
+            }
+        }
+    }
+};
+
+
+//
+//  AVL Tree:
+//   Bias is the allowed imbalance of the AVL tree which is set as a private member variable.
+//
+template <typename T>
+class myAVLTree{
+public:
+    myAVLTree() = default;
+    // You can choose to pass a bias value as b, if you want to change bias. And b should be non-negative.
+    myAVLTree(const myAVLTree &rhs, int b = 1){
+        if (b < 0) {
+            cerr << "Error: bias should be non-negative." << endl;
+            return;
+        }
+        root = clone(rhs.root);
+        bias = b;
+    }
+    myAVLTree(myAVLTree &&rhs, int b = 1){
+        if (b < 0) {
+            cerr << "Error: bias should be non-negative." << endl;
+            return;
+        }
+        root = rhs.root;
+        stats = rhs.stats;
+        bias = b;
+        rhs.root = nullptr;
+        rhs.stats = myAllocStats();
+    }
+    ~myAVLTree(){
+        clear(root);
+    }
+    void clear() {
+        clear(root);
+    }
+    bool empty() const {
+        return root == nullptr;
+    }
+    // Allocation statistics, one live block per element.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
+
+    // Get the height of the tree.
+    int getHeight() const {
+        return getHeight(root);
+    }
+    // Number of values, every node keeps the size of its subtree.
+    size_t size() const {
+        return sizeOf(root);
+    }
+
+    //
+    // Order statistics in O(log n), from the subtree sizes kept by rotations and balance():
+    //  select(k) is the value of rank k (0-based, the k + 1 smallest), rank(x) counts values less than x,
+    //  so select(rank(x)) == x for a value in the tree. countInRange(lo, hi) counts values in [lo, hi].
+    //
+    T select(size_t k) const {
+        PTIME_SCOPE("myAVLTree::select");
+        if (k >= size()){
+            cerr << "Error: select rank " << k << " out of tree of size " << size() << "." << endl;
+            return {};
+        }
+        node *ptr = root;
+        while (true){
+            size_t leftSize = sizeOf(ptr->left);
+            if (k == leftSize) return ptr->value;
+            if (k < leftSize){
+                ptr = ptr->left;
+            } else {
+                k -= leftSize + 1;
+                ptr = ptr->right;
+            }
+        }
+    }
+    size_t rank(const T &x) const {
+        PTIME_SCOPE("myAVLTree::rank");
+        return countBelow(x, false);
+    }
+    size_t countInRange(const T &lo, const T &hi) const {
+        PTIME_SCOPE("myAVLTree::countInRange");
+        if (hi < lo) return 0;
+        return countBelow(hi, true) - countBelow(lo, false);
+    }
+
+    // find the maximum and minimum
+    T max() const {
+        node *maxNode = max(root);
+        if (maxNode == nullptr){
+            cerr << "Error: cannot get the maximum of empty tree." << endl;
+            return {};
+        }
+        return maxNode->value;
+    }
+    T min() const {
+        node *minNode = min(root);
+        if (minNode == nullptr){
+            cerr << "Error: cannot get the minimum of empty tree." << endl;
+            return {};
+        }
+        return minNode->value;
+    }
+
+    // public contain, insert and remove, just like them in myBST.
+    bool contain(const T&val) const {
+        PTIME_SCOPE("myAVLTree::contain");
+        return contain(val, root);
+    }
+    void insert(const T &val) {
+        PTIME_SCOPE("myAVLTree::insert");
+        insert(val, root);
+    }
+    void insert(T &&val){
+        PTIME_SCOPE("myAVLTree::insert");
+        insert(std::move(val), root);
+    }
+    void remove(const T &val){
+        PTIME_SCOPE("myAVLTree::remove");
+        remove(val, root);
+    }
+    void remove(T &&val){
+        PTIME_SCOPE("myAVLTree::remove");
+        remove(val, root);
+    }
+    // Visit values in ascending order, the same as myBST.
+    template <typename Func>
+    void forEach(const Func &func) const {
+        inOrderVisit(root, func);
+    }
+
+    //
+    // Bulk and set operations, all built on join(), see Blelloch, Ferizovic and Sun, "Just join for parallel ordered sets".
+    //  1. buildFromSorted() builds a perfectly balanced tree in O(n).
+    //  2. split() and join() take O(log n). Nodes are moved, never copied.
+    //  3. unionWith(), intersectWith() and difference() split rhs by the root of this tree and recurse on both halves,
+    //     as a fork / join pair on pool while the subtrees are higher than grainHeight. rhs is consumed,
+    //     pass std::move(other) to save the copy. O(m log(n / m + 1)) work for sizes m <= n.
+    //  4. With MYDSA_ALLOC_STATS, nodes moved between trees count as freed by one tree and allocated by the other.
+    //
+
+    // sorted should be ascending without repeat values
+    void buildFromSorted(const vector<T> &sorted) {
+        PTIME_SCOPE("myAVLTree::buildFromSorted");
+        if (std::adjacent_find(sorted.begin(), sorted.end(), [](const T &a, const T &b){ return !(a < b); }) != sorted.end()){
+            cerr << "Error: buildFromSorted needs ascending values without repeat." << endl;
+            return;
+        }
+        clear();
+        root = build(sorted, 0, sorted.size());
+    }
+    // Move values less than key to left and values greater than key to right, this tree becomes empty.
+    // Return whether key was in the tree. left and right are cleared first and should be other trees.
+    bool split(const T &key, myAVLTree &left, myAVLTree &right) {
+        PTIME_SCOPE("myAVLTree::split");
+        left.clear();
+        right.clear();
+        left.bias = right.bias = bias;
+        node *mid = nullptr;
+        split(root, key, left.root, mid, right.root);
+        root = nullptr;
+        left.adopt(*this, left.size());
+        right.adopt(*this, right.size());
+        if (mid != nullptr) deleteNode(mid);
+        return mid != nullptr;
+    }
+    // Tree of left, key and right, all values of left should be less than key and all of right greater.
+    // left and right become empty.
+    static myAVLTree join(myAVLTree &left, const T &key, myAVLTree &right) {
+        PTIME_SCOPE("myAVLTree::join");
+        myAVLTree result;
+        if ((!left.empty() && !(left.max() < key)) || (!right.empty() && !(key < right.min()))){
+            cerr << "Error: join needs left < key < right." << endl;
+            return result;
+        }
+        result.bias = std::max(left.bias, right.bias);
+        result.adopt(left, left.stats.liveBlocks());
+        result.adopt(right, right.stats.liveBlocks());
+        result.root = result.join(left.root, result.newNode(key, nullptr, nullptr, 0), right.root);
+        left.root = right.root = nullptr;
+        return result;
+    }
+
+    void unionWith(myAVLTree rhs, myThreadPool &pool = myThreadPool::instance(), int grainHeight = 12) {
+        PTIME_SCOPE("myAVLTree::unionWith");
+        std::atomic<uint64_t> freed{0};
+        takeNodes(rhs);
+        root = unionOf(root, rhs.root, {pool, grainHeight, freed});
+        rhs.root = nullptr;
+        countFreed(freed);
+    }
+    void intersectWith(myAVLTree rhs, myThreadPool &pool = myThreadPool::instance(), int grainHeight = 12) {
+        PTIME_SCOPE("myAVLTree::intersectWith");
+        std::atomic<uint64_t> freed{0};
+        takeNodes(rhs);
+        root = intersectionOf(root, rhs.root, {pool, grainHeight, freed});
+        rhs.root = nullptr;
+        countFreed(freed);
+    }
+    // Remove all values of rhs from this tree
+    void difference(myAVLTree rhs, myThreadPool &pool = myThreadPool::instance(), int grainHeight = 12) {
+        PTIME_SCOPE("myAVLTree::difference");
+        std::atomic<uint64_t> freed{0};
+        takeNodes(rhs);
+        root = differenceOf(root, rhs.root, {pool, grainHeight, freed});
+        rhs.root = nullptr;
+        countFreed(freed);
+    }
+
+private:
+    // inner node structure, there is a height member additional,
+    // and the number of nodes of the subtree (fits in the padding after height).
+    struct node {
+        T value;
+        node *left = nullptr;
+        node *right = nullptr;
+        int height = 0;
+        uint32_t size = 1;
+        node(const T &val, node *l, node *r, int h):
+            value(val), left(l), right(r), height(h), size(1 + sizeOf(l) + sizeOf(r)) {}
+        node(T &&val, node *l, node *r, int h):
+            value(std::move(val)), left(l), right(r), height(h), size(1 + sizeOf(l) + sizeOf(r)) {}
+    };
+    // get the height of the node. For convenience, we set height of nullptr as -1.
+    int getHeight(node *ptr) const {
+        return ptr == nullptr ? -1 : ptr->height;
+    }
+    static uint32_t sizeOf(const node *ptr) {
+        return ptr == nullptr ? 0 : ptr->size;
+    }
+    // Height and size of a node from its children
+    void update(node *ptr) {
+        ptr->height = std::max(getHeight(ptr->left), getHeight(ptr->right)) + 1;
+        ptr->size = 1 + sizeOf(ptr->left) + sizeOf(ptr->right);
+    }
+    // return a clone of the node structure.
+    node *clone(node *ptr) {
+        if (ptr == nullptr) return nullptr;
+        return newNode(ptr->value, clone(ptr->left), clone(ptr->right), ptr->height);
+    }
+    // All nodes are created and destroyed here, so they can be counted.
+    template <typename... Args>
+    node *newNode(Args &&...args) {
+        stats.onAlloc(sizeof(node));
+        return new node{std::forward<Args>(args)...};
+    }
+    void deleteNode(node *ptr) {
+        stats.onFree(sizeof(node));
+        delete ptr;
+    }
+    void clear(node *&ptr) {
+        if (ptr == nullptr) return;
+        clear(ptr->left);
+        clear(ptr->right);
+        deleteNode(ptr);
+        ptr = nullptr;
+    }
+    node *max(node *ptr) const {
+        if (ptr == nullptr) return nullptr;
+        node *maxNode = ptr;
+        while (maxNode->right != nullptr)
+            maxNode = maxNode->right;
+        return maxNode;
+    }
+    node *min(node* ptr) const {
+        if (ptr == nullptr) return nullptr;
+        node *minNode = ptr;
+        while (minNode->left != nullptr)
+            minNode = minNode->left;
+        return minNode;
+    }
+    bool contain(const T &val, node *ptr) const {
+        if (ptr == nullptr) return false;
+        if (val < ptr->value) return contain(val, ptr->left);
+        if (val > ptr->value) return contain(val, ptr->right);
+        return true;
+    }
+
+    // In AVL tree, insert and remove routines should apply balance() routine to balance the AVL tree.
+    void insert(const T &val, node *&ptr) {
+        if (ptr == nullptr) {
+            ptr = newNode(val, nullptr, nullptr, 0);
+        } else if (val < ptr->value){
+            insert(val, ptr->left);
+        } else if (val > ptr->value){
+            insert(val, ptr->right);
+        } else {
+            // cerr << "Error: inserted value already exists." << endl;
+            return;
+        }
+        // Additional balance routine
+        balance(ptr);
+    }
+    void insert(T &&val, node *&ptr){
+        if (ptr == nullptr){
+            ptr = newNode(std::move(val), nullptr, nullptr, 0);
+        } else if (val < ptr->value){
+            insert(val, ptr->left);
+        } else if (val > ptr->value){
+            insert(val, ptr->right);
+        } else {
+            // cerr << "Error: inserted value already exists." << endl;
+            return;
+        }
+        balance(ptr);
+    }
+
+    void remove(const T &val, node *&ptr){
+        if (ptr == nullptr){
+            // cerr << "Error: removed value dosen't exist." << endl;
+            return;
+        } else if (val < ptr->value){
+            remove(val, ptr->left);
+        } else if (val > ptr->value){
+            remove(val, ptr->right);
+        } else if (ptr->left != nullptr && ptr->right != nullptr){
+            // Two children: take the minimum of right subtree, then remove it from right subtree.
+            ptr->value = min(ptr->right)->value;
+            remove(ptr->value, ptr->right);
+        } else {
+            // At most one child: replace the node by the child.
+            node *oldNode = ptr;
+            ptr = ptr->left != nullptr ? ptr->left : ptr->right;
+            deleteNode(oldNode);
+        }
+        balance(ptr);
+    }
+
+    // Critical in AVL tree!
+    // balance routine
+    void balance(node *&ptr) {
+        if (ptr == nullptr) return;
+        if (getHeight(ptr->left) - getHeight(ptr->right) > bias) {
+            // Left child overload, single rotate or double rotate
+            // Equal heights only happen after remove(), and need a single rotate.
+            if (getHeight(ptr->left->left) >= getHeight(ptr->left->right))
+                rotateLeft(ptr);
+            else
+                doubleRotateLeft(ptr);
+        } else if (getHeight(ptr->right) - getHeight(ptr->left) > bias) {
+            // Right child overload, single rotate or double rotate
+            if (getHeight(ptr->right->right) >= getHeight(ptr->right->left))
+                rotateRight(ptr);
+            else
+                doubleRotateRight(ptr);
+        }
+        // Rotate routines update rotated nodes, the height and size of ptr still need update.
+        update(ptr);
+    }
+
+    // Single rotate with left child
+    void rotateLeft(node *&ptr) {
+        // Rotate
+        node *newPtr = ptr->left;
+        ptr->left = newPtr->right;
+        newPtr->right = ptr;
+        // Update height and size
+        update(ptr);
+        update(newPtr);
+
+        ptr = newPtr;
+    }
+    // Single rotate with right child
+    void rotateRight(node *&ptr) {
+        // Rotate
+        node *newPtr = ptr->right;
+        ptr->right = newPtr->left;
+        newPtr->left = ptr;
+        // Update height and size
+        update(ptr);
+        update(newPtr);
+
+        ptr = newPtr;
+    }
+    // Double rotate can be decomposed as two single rotates
+    void doubleRotateLeft(node *&ptr) {
+        rotateRight(ptr->left);
+        rotateLeft(ptr);
+    }
+    void doubleRotateRight(node *&ptr) {
+        rotateLeft(ptr->right);
+        rotateRight(ptr);
+    }
+
+    // Perfectly balanced tree of sorted[begin, end)
+    node *build(const vector<T> &sorted, size_t begin, size_t end) {
+        if (begin == end) return nullptr;
+        size_t mid = begin + (end - begin) / 2;
+        node *left = build(sorted, begin, mid);
+        node *right = build(sorted, mid + 1, end);
+        return newNode(sorted[mid], left, right, std::max(getHeight(left), getHeight(right)) + 1);
+    }
+    // Join left < mid < right, mid is a detached node. Descend the spine of the taller tree until the heights
+    // are within bias, hang mid there, and balance on the way back like insert().
+    node *join(node *left, node *mid, node *right) {
+        if (getHeight(left) > getHeight(right) + bias){
+            left->right = join(left->right, mid, right);
+            balance(left);
+            return left;
+        }
+        if (getHeight(right) > getHeight(left) + bias){
+            right->left = join(left, mid, right->left);
+            balance(right);
+            return right;
+        }
+        mid->left = left;
+        mid->right = right;
+        update(mid);
+        return mid;
+    }
+    // Join without a middle value, the maximum of left is taken out to be the middle node
+    node *join(node *left, node *right) {
+        if (left == nullptr) return right;
+        node *mid = nullptr;
+        left = splitMax(left, mid);
+        return join(left, mid, right);
+    }
+    node *splitMax(node *ptr, node *&maxNode) {
+        if (ptr->right == nullptr){
+            maxNode = ptr;
+            return ptr->left;
+        }
+        ptr->right = splitMax(ptr->right, maxNode);
+        balance(ptr);
+        return ptr;
+    }
+    // Split ptr into values less than key and greater than key, the node of key (if any) is detached to mid
+    void split(node *ptr, const T &key, node *&left, node *&mid, node *&right) {
+        if (ptr == nullptr){
+            left = mid = right = nullptr;
+            return;
+        }
+        node *l = ptr->left, *r = ptr->right;
+        if (key < ptr->value){
+            split(l, key, left, mid, right);
+            right = join(right, ptr, r);
+        } else if (ptr->value < key){
+            split(r, key, left, mid, right);
+            left = join(l, ptr, left);
+        } else {
+            left = l;
+            right = r;
+            mid = ptr;
+            mid->left = mid->right = nullptr;
+            update(mid);
+        }
+    }
+
+    // Set operations run on several threads, which cannot share stats. Freed nodes are counted
+    // in freed and added to stats by the calling thread at the end.
+    struct setContext {
+        myThreadPool &pool;
+        int grainHeight;
+        std::atomic<uint64_t> &freed;
+    };
+    void discard(node *ptr, const setContext &ctx) {
+        delete ptr;
+        ctx.freed.fetch_add(1, std::memory_order_relaxed);
+    }
+    void discardAll(node *ptr, const setContext &ctx) {
+        if (ptr == nullptr) return;
+        discardAll(ptr->left, ctx);
+        discardAll(ptr->right, ctx);
+        discard(ptr, ctx);
+    }
+    // Run the two recursive calls of a set operation, forked when the input trees are high enough
+    template <typename Left, typename Right>
+    void forkJoin(int height, const setContext &ctx, const Left &left, const Right &right) {
+        if (height <= ctx.grainHeight){
+            left();
+            right();
+            return;
+        }
+        myTaskGroup group(ctx.pool);
+        group.fork(left);
+        right();
+        group.join();
+    }
+    node *unionOf(node *a, node *b, const setContext &ctx) {
+        if (a == nullptr) return b;
+        if (b == nullptr) return a;
+        int height = std::max(getHeight(a), getHeight(b));
+        node *l2, *mid, *r2, *left, *right;
+        split(b, a->value, l2, mid, r2);
+        if (mid != nullptr) discard(mid, ctx);
+        node *l1 = a->left, *r1 = a->right;
+        forkJoin(height, ctx, [&]{ left = unionOf(l1, l2, ctx); }, [&]{ right = unionOf(r1, r2, ctx); });
+        return join(left, a, right);
+    }
+    node *intersectionOf(node *a, node *b, const setContext &ctx) {
+        if (a == nullptr || b == nullptr){
+            discardAll(a, ctx);
+            discardAll(b, ctx);
+            return nullptr;
+        }
+        int height = std::max(getHeight(a), getHeight(b));
+        node *l2, *mid, *r2, *left, *right;
+        split(b, a->value, l2, mid, r2);
+        node *l1 = a->left, *r1 = a->right;
+        forkJoin(height, ctx, [&]{ left = intersectionOf(l1, l2, ctx); }, [&]{ right = intersectionOf(r1, r2, ctx); });
+        if (mid == nullptr){
+            discard(a, ctx);
+            return join(left, right);
+        }
+        discard(mid, ctx);
+        return join(left, a, right);
+    }
+    node *differenceOf(node *a, node *b, const setContext &ctx) {
+        if (a == nullptr || b == nullptr){
+            discardAll(b, ctx);
+            return a;
+        }
+        int height = std::max(getHeight(a), getHeight(b));
+        node *l1, *mid, *r1, *left, *right;
+        split(a, b->value, l1, mid, r1);
+        if (mid != nullptr) discard(mid, ctx);
+        node *l2 = b->left, *r2 = b->right;
+        discard(b, ctx);
+        forkJoin(height, ctx, [&]{ left = differenceOf(l1, l2, ctx); }, [&]{ right = differenceOf(r1, r2, ctx); });
+        return join(left, right);
+    }
+    // Number of values less than x, or not greater than x when inclusive
+    size_t countBelow(const T &x, bool inclusive) const {
+        size_t count = 0;
+        for (node *ptr = root; ptr != nullptr;){
+            if (ptr->value < x || (inclusive && !(x < ptr->value))){
+                count += sizeOf(ptr->left) + 1;
+                ptr = ptr->right;
+            } else {
+                ptr = ptr->left;
+            }
+        }
+        return count;
+    }
+    // Statistics of moved nodes (see split() and join())
+    void adopt(myAVLTree &from, uint64_t nodes) {
+        for (; nodes > 0; --nodes){
+            from.stats.onFree(sizeof(node));
+            stats.onAlloc(sizeof(node));
+        }
+    }
+    void takeNodes(myAVLTree &rhs) {
+        bias = std::max(bias, rhs.bias);
+        adopt(rhs, rhs.stats.liveBlocks());
+    }
+    void countFreed(const std::atomic<uint64_t> &freed) {
+        for (uint64_t n = freed.load(); n > 0; --n)
+            stats.onFree(sizeof(node));
+    }
+
+    node *root = nullptr;
+    int bias = 1;
+    myAllocStats stats;
+};
+
+//
+// Splay Tree:
+//  From top down splay. From bottom up method is another way of splay, which is much easier.
+//
+template <typename T>
+class mySplayTree {
+public:
+    // default constructor
+    mySplayTree() = default;
+    // copy constructor
+    mySplayTree(const mySplayTree &rhs) {
+        root = clone(rhs.root);
+    }
+    mySplayTree(mySplayTree &&rhs){
+        root = rhs.root;
+        stats = rhs.stats;
+        rhs.root = nullptr;
+        rhs.stats = myAllocStats();
+    }
+    ~mySplayTree() {
+        clear(root);
+    }
+    bool empty() const {
+        return root == nullptr;
+    }
+
+    void clear() {
+        clear(root);
+    }
+    // Allocation statistics, one live block per element.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
+
+    // Just splay and test the root value.
+    bool contain(const T &val){
+        PTIME_SCOPE("mySplayTree::contain");
+        if (root == nullptr) return false;
+        splay(val, root);
+        return root->value == val;
+    }
+    bool contain(T &&val){
+        // use left reference version instead, cause splay function receive left reference only.
+        return contain(val);
+    }
+
+    // Get the maximum and minimum value of splay tree
+    // After access the maximum or minimum value, a splay function should be applied.
+    T max(){
+        if (root == nullptr){
+            cerr << "Error: cannot get the maximum of empty tree." << endl;
+            return {};
+        }
+        node *maxNode = root;
+        while (maxNode->right != nullptr)
+            maxNode = maxNode->right;
+        splay(maxNode->value, root);
+        return maxNode->value;    
+    }
+    T min(){
+        if (root == nullptr){
+            cerr << "Error: cannot get the minimum of empty tree." << endl;
+            return {};
+        }
+        node *minNode = root;
+        while (minNode->left != nullptr)
+            minNode = minNode->left;
+        splay(minNode->value, root);
+        return minNode->value;
+    }
+
+    // insert without recursion, top down way.
+    // using splay function instead.
+    void insert(const T &val) {
+        PTIME_SCOPE("mySplayTree::insert");
+        if (root == nullptr){
+            root = newNode(val, nullptr, nullptr);
+            return;
+        }
+        // splay val to see whether val already exists.
+        // Create the new node only when val is not found.
+        splay(val, root);
+        if (val < root->value){
+            node *ptr = newNode(val, root->left, root);
+            root->left = nullptr;
+            root = ptr;
+        } else if (val > root->value) {
+            node *ptr = newNode(val, root, root->right);
+            root->right = nullptr;
+            root = ptr;
+        } else{
+            // cerr << <"Error: inserted value already exists." << endl;
+        }
+    }
+    void insert(T &&val) {
+        // use left reference one. cause only left reference splay function are provided.
+        insert(val);
+    }
+    
+    // remove without recursion, top down way
+    // use splay function instead.
+    void remove(const T& val) {
+        PTIME_SCOPE("mySplayTree::remove");
+        if (!contain(val)){
+            // cerr << "Error: removed value dosen't exist." << endl;
+            return;
+        }
+        if (root->left == nullptr){
+            node *oldRoot = root;
+            root = root->right;
+            deleteNode(oldRoot);
+        } else {
+            // splay to move the maximum node of left tree to its root
+            splay(val, root->left);
+            root->left->right = root->right;
+            node *oldRoot = root;
+            root = root->left;
+            deleteNode(oldRoot);
+        }
+    }
+    void remove(T &&val) {
+        // use left reference version.
+        remove(val);
+    }
+
+    // The same as myBST, a splay tree can be as deep as a list.
+    template <typename Func>
+    void forEach(const Func &func) const {
+        inOrderVisit(root, func);
+    }
+
+private:
+    // Inner node structure
+    struct node {
+        T value;
+        node *left;
+        node *right;
+        node(const T &val, node *l, node *r):
+            value(val), left(l), right(r) {}
+        node(T &&val, node *l, node *r):
+            value(std::move(val)), left(l),right(r) {}
+    };
+
+    // The same as AVL tree. Recursive way.
+    node *clone(node *ptr) {
+        if (ptr == nullptr) return nullptr;
+        return newNode(ptr->value, clone(ptr->left), clone(ptr->right));
+    }
+
+    // All nodes are created and destroyed here, so they can be counted.
+    template <typename... Args>
+    node *newNode(Args &&...args) {
+        stats.onAlloc(sizeof(node));
+        return new node{std::forward<Args>(args)...};
+    }
+    void deleteNode(node *ptr) {
+        stats.onFree(sizeof(node));
+        delete ptr;
+    }
+
+    // The same as AVL tree. Recursive way.
+    void clear(node *&ptr) {
+        if (ptr == nullptr) return;
+        clear(ptr->left);
+        clear(ptr->right);
+        deleteNode(ptr);
+        ptr = nullptr;
+    }
+
+    // From top down splay
+    // make the node containing x at the root.
+    // if x is not found, make the last node at the root
+    // only left reference type is provided.
+    void splay(const T&x, node *&ptr) {
+        if (ptr == nullptr) return;
+        // header node contains left and right tree root.
+        // header is just a auxiliary node on the stack, so a splay does not allocate.
+        node headerNode{T{}, nullptr, nullptr};
+        node *header = &headerNode;
+        // leftMax and rightMin contain maximum node of left tree and minimum node of right tree
+        // initially, leftMax and rightMin set set to header.
+        node *leftMax = header, *rightMin = header;
+        while (true){
+            if (x < ptr->value){
+                if (ptr->left == nullptr) break;
+                // zig-zig case require a additional AVL single rotate (the same as AVL tree)
+                if (x < ptr->left->value && ptr->left->left != nullptr)
                     rotateLeft(ptr);
                 // splay (top down) single rotate (not the same as AVL rotate)
                 rightMin->left = ptr;
@@ -1288,67 +5352,1770 @@ private:
                 break;  // the case when x is at the root
         }
 
-        // put together three parts of the tree
-        leftMax->right = ptr->left;
-        rightMin->left = ptr->right;
-        ptr->left = header->right;
-        ptr->right = header->left;
-        delete header;
+        // put together three parts of the tree
+        leftMax->right = ptr->left;
+        rightMin->left = ptr->right;
+        ptr->left = header->right;
+        ptr->right = header->left;
+    }
+
+    // single rotate routine (the same as AVL tree implementation)
+    // and no need to update height !
+    void rotateLeft(node *&ptr){
+        node *newPtr = ptr->left;
+        ptr->left = newPtr->right;
+        newPtr->right = ptr;
+        ptr = newPtr;
+
+    }
+    void rotateRight(node *&ptr){
+        node *newPtr = ptr->right;
+        ptr->right = newPtr->left;
+        newPtr->left = ptr;
+        ptr = newPtr;
+    }
+    node *root = nullptr;
+    myAllocStats stats;
+};
+
+
+//
+// B+ Tree:
+//  1. Keys are stored in nodes of about Bytes bytes (default 256, four cache lines; 4096 fits a page),
+//     so a lookup touches log_B(n) nodes instead of log_2(n).
+//  2. Inner nodes hold separators and children, keys live only in leaves. Leaves are doubly linked for range scans.
+//  3. Intra-node search of int keys compares 8 (AVX2) or 4 (SSE2) keys at once and counts the smaller ones,
+//     other key types use binary search.
+//  4. Same surface as myAVLTree: insert / remove / contain / min / max. Repeat insertion is ignored.
+//     remove() rebalances by borrowing from a sibling or merging, so every node except the root is at least half full.
+//
+template <typename T, unsigned Bytes = 256>
+class myBPlusTree {
+public:
+    myBPlusTree() = default;
+    myBPlusTree(const myBPlusTree &rhs) {
+        rhs.forEach([this](const T &val){ insert(val); });
+    }
+    myBPlusTree(myBPlusTree &&rhs) {
+        swap(rhs);
+    }
+    myBPlusTree &operator=(myBPlusTree rhs) {
+        swap(rhs);
+        return *this;
+    }
+    ~myBPlusTree(){
+        clear();
+    }
+    void swap(myBPlusTree &rhs) {
+        std::swap(root, rhs.root);
+        std::swap(head, rhs.head);
+        std::swap(tail, rhs.tail);
+        std::swap(elements, rhs.elements);
+        std::swap(height, rhs.height);
+        std::swap(stats, rhs.stats);
+    }
+    void clear() {
+        clear(root);
+        root = nullptr;
+        head = tail = nullptr;
+        elements = 0;
+        height = 0;
+    }
+    bool empty() const {
+        return elements == 0;
+    }
+    size_t size() const {
+        return elements;
+    }
+    // Allocation statistics, one live block per node.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
+    // Number of levels, -1 for an empty tree (a single leaf is height 0, as a single node of myAVLTree)
+    int getHeight() const {
+        return height - 1;
+    }
+
+    T max() const {
+        if (empty()){
+            cerr << "Error: cannot get the maximum of empty tree." << endl;
+            return {};
+        }
+        return tail->keys[tail->count - 1];
+    }
+    T min() const {
+        if (empty()){
+            cerr << "Error: cannot get the minimum of empty tree." << endl;
+            return {};
+        }
+        return head->keys[0];
+    }
+
+    bool contain(const T &val) const {
+        PTIME_SCOPE("myBPlusTree::contain");
+        if (root == nullptr) return false;
+        const leaf *ptr = findLeaf(val);
+        unsigned pos = lowerBound(ptr->keys, ptr->count, val);
+        return pos < ptr->count && !(val < ptr->keys[pos]);
+    }
+    void insert(const T &val) {
+        PTIME_SCOPE("myBPlusTree::insert");
+        insertRoot(val);
+    }
+    void insert(T &&val) {
+        PTIME_SCOPE("myBPlusTree::insert");
+        insertRoot(std::move(val));
+    }
+    void remove(const T &val) {
+        PTIME_SCOPE("myBPlusTree::remove");
+        if (root == nullptr) return;
+        remove(root, val);
+        if (!root->isLeaf && root->count == 0){
+            // Root with a single child, the tree gets one level lower
+            node *oldRoot = root;
+            root = static_cast<inner *>(root)->children[0];
+            deleteNode(static_cast<inner *>(oldRoot));
+            --height;
+        } else if (root->isLeaf && root->count == 0){
+            deleteNode(static_cast<leaf *>(root));
+            root = nullptr;
+            head = tail = nullptr;
+            height = 0;
+        }
+    }
+
+    // Visit keys in ascending order, by the leaf links
+    template <typename Func>
+    void forEach(const Func &func) const {
+        for (const leaf *ptr = head; ptr != nullptr; ptr = ptr->next)
+            for (unsigned i = 0; i < ptr->count; ++i)
+                func(ptr->keys[i]);
+    }
+    // Visit keys in [low, high] in ascending order: one descent, then a walk along the leaves
+    template <typename Func>
+    void forEachInRange(const T &low, const T &high, const Func &func) const {
+        if (root == nullptr || high < low) return;
+        const leaf *ptr = findLeaf(low);
+        unsigned i = lowerBound(ptr->keys, ptr->count, low);
+        for (; ptr != nullptr; ptr = ptr->next, i = 0)
+            for (; i < ptr->count; ++i){
+                if (high < ptr->keys[i]) return;
+                func(ptr->keys[i]);
+            }
+    }
+
+private:
+    // Node capacities fill Bytes, rounded down to a multiple of 8 keys for the SIMD search
+    static constexpr unsigned roundCapacity(size_t n) {
+        return n >= 16 ? static_cast<unsigned>(n / 8 * 8) : std::max<unsigned>(static_cast<unsigned>(n), 4);
+    }
+    // Node header: count, isLeaf and the leaf links, or the extra child pointer of an inner node
+    static constexpr size_t LEAF_HEADER = 2 * sizeof(void *) + 8;
+    static constexpr size_t INNER_HEADER = sizeof(void *) + 8;
+    static_assert(Bytes >= LEAF_HEADER + 4 * sizeof(T), "myBPlusTree: Bytes must fit the leaf header and 4 keys");
+    static_assert(Bytes >= INNER_HEADER + 4 * (sizeof(T) + sizeof(void *)), "myBPlusTree: Bytes must fit the inner header and 4 keys");
+    static constexpr unsigned LEAF_CAPACITY = roundCapacity((Bytes - LEAF_HEADER) / sizeof(T));
+    static constexpr unsigned INNER_CAPACITY = roundCapacity((Bytes - INNER_HEADER) / (sizeof(T) + sizeof(void *)));
+    static_assert(LEAF_CAPACITY >= 4 && INNER_CAPACITY >= 4, "myBPlusTree: nodes need at least 4 keys");
+    static constexpr unsigned LEAF_MIN = LEAF_CAPACITY / 2;
+    static constexpr unsigned INNER_MIN = INNER_CAPACITY / 2;
+
+    struct node {
+        unsigned count = 0;
+        bool isLeaf;
+        explicit node(bool l): isLeaf(l) {}
+    };
+    struct alignas(64) leaf : node {
+        T keys[LEAF_CAPACITY]{};
+        leaf *prev = nullptr;
+        leaf *next = nullptr;
+        leaf(): node(true) {}
+    };
+    // children[i] holds keys in [keys[i-1], keys[i])
+    struct alignas(64) inner : node {
+        T keys[INNER_CAPACITY]{};
+        node *children[INNER_CAPACITY + 1]{};
+        inner(): node(false) {}
+    };
+
+    node *root = nullptr;
+    leaf *head = nullptr;
+    leaf *tail = nullptr;
+    size_t elements = 0;
+    int height = 0;
+    myAllocStats stats;
+
+    // All nodes are created and destroyed here, so they can be counted.
+    template <typename N>
+    N *newNode() {
+        stats.onAlloc(sizeof(N));
+        return new N;
+    }
+    template <typename N>
+    void deleteNode(N *ptr) {
+        stats.onFree(sizeof(N));
+        delete ptr;
+    }
+    void clear(node *ptr) {
+        if (ptr == nullptr) return;
+        if (ptr->isLeaf){
+            deleteNode(static_cast<leaf *>(ptr));
+            return;
+        }
+        inner *in = static_cast<inner *>(ptr);
+        for (unsigned i = 0; i <= in->count; ++i)
+            clear(in->children[i]);
+        deleteNode(in);
+    }
+
+    // Number of keys smaller than val in keys[0, count)
+    template <unsigned Capacity>
+    static unsigned lowerBound(const T (&keys)[Capacity], unsigned count, const T &val) {
+# if defined(__AVX2__) || defined(__SSE2__)
+        if constexpr (std::is_same<T, int>::value && Capacity % 8 == 0){
+            unsigned smaller = 0;
+#   if defined(__AVX2__)
+            const __m256i target = _mm256_set1_epi32(val);
+            for (unsigned i = 0; i < count; i += 8){
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+                unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(target, block)));
+                if (count - i < 8) mask &= (1u << (count - i)) - 1;
+                smaller += __builtin_popcount(mask);
+                if (mask != 0xFF) break;
+            }
+#   else
+            const __m128i target = _mm_set1_epi32(val);
+            for (unsigned i = 0; i < count; i += 4){
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+                unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(target, block)));
+                if (count - i < 4) mask &= (1u << (count - i)) - 1;
+                smaller += __builtin_popcount(mask);
+                if (mask != 0xF) break;
+            }
+#   endif
+            return smaller;
+        }
+# endif
+        return std::lower_bound(keys, keys + count, val) - keys;
+    }
+    // Child of an inner node which may hold val
+    static unsigned childIndex(const inner *ptr, const T &val) {
+        unsigned i = lowerBound(ptr->keys, ptr->count, val);
+        return i < ptr->count && !(val < ptr->keys[i]) ? i + 1 : i;
+    }
+    const leaf *findLeaf(const T &val) const {
+        const node *ptr = root;
+        while (!ptr->isLeaf){
+            const inner *in = static_cast<const inner *>(ptr);
+            ptr = in->children[childIndex(in, val)];
+        }
+        return static_cast<const leaf *>(ptr);
+    }
+
+    template <typename U>
+    void insertRoot(U &&val) {
+        if (root == nullptr){
+            leaf *first = newNode<leaf>();
+            root = head = tail = first;
+            height = 1;
+        }
+        T up{};
+        node *right = insert(root, std::forward<U>(val), up);
+        if (right != nullptr){
+            // Root split, the tree gets one level higher
+            inner *newRoot = newNode<inner>();
+            newRoot->keys[0] = std::move(up);
+            newRoot->children[0] = root;
+            newRoot->children[1] = right;
+            newRoot->count = 1;
+            root = newRoot;
+            ++height;
+        }
+    }
+
+    // Insert val under ptr. If ptr splits, return the new right sibling and set up to its separator.
+    template <typename U>
+    node *insert(node *ptr, U &&val, T &up) {
+        if (ptr->isLeaf){
+            leaf *lf = static_cast<leaf *>(ptr);
+            unsigned pos = lowerBound(lf->keys, lf->count, val);
+            if (pos < lf->count && !(val < lf->keys[pos])) return nullptr;
+            ++elements;
+            if (lf->count < LEAF_CAPACITY){
+                std::move_backward(lf->keys + pos, lf->keys + lf->count, lf->keys + lf->count + 1);
+                lf->keys[pos] = std::forward<U>(val);
+                ++lf->count;
+                return nullptr;
+            }
+            return splitLeaf(lf, pos, std::forward<U>(val), up);
+        }
+        inner *in = static_cast<inner *>(ptr);
+        unsigned i = childIndex(in, val);
+        T childUp{};
+        node *childRight = insert(in->children[i], std::forward<U>(val), childUp);
+        if (childRight == nullptr) return nullptr;
+        if (in->count < INNER_CAPACITY){
+            std::move_backward(in->keys + i, in->keys + in->count, in->keys + in->count + 1);
+            std::move_backward(in->children + i + 1, in->children + in->count + 1, in->children + in->count + 2);
+            in->keys[i] = std::move(childUp);
+            in->children[i + 1] = childRight;
+            ++in->count;
+            return nullptr;
+        }
+        return splitInner(in, i, std::move(childUp), childRight, up);
+    }
+
+    // Full leaf: the CAPACITY + 1 keys are divided in two halves
+    template <typename U>
+    node *splitLeaf(leaf *lf, unsigned pos, U &&val, T &up) {
+        T all[LEAF_CAPACITY + 1];
+        std::move(lf->keys, lf->keys + pos, all);
+        all[pos] = std::forward<U>(val);
+        std::move(lf->keys + pos, lf->keys + LEAF_CAPACITY, all + pos + 1);
+        leaf *right = newNode<leaf>();
+        unsigned half = (LEAF_CAPACITY + 1) / 2;
+        std::move(all, all + half, lf->keys);
+        std::move(all + half, all + LEAF_CAPACITY + 1, right->keys);
+        lf->count = half;
+        right->count = LEAF_CAPACITY + 1 - half;
+        // Link leaves
+        right->next = lf->next;
+        right->prev = lf;
+        if (lf->next != nullptr) lf->next->prev = right;
+        else tail = right;
+        lf->next = right;
+        up = right->keys[0];
+        return right;
+    }
+    // Full inner node: of the CAPACITY + 1 separators the middle one moves up
+    node *splitInner(inner *in, unsigned pos, T &&key, node *child, T &up) {
+        T keys[INNER_CAPACITY + 1];
+        node *children[INNER_CAPACITY + 2];
+        std::move(in->keys, in->keys + pos, keys);
+        keys[pos] = std::move(key);
+        std::move(in->keys + pos, in->keys + INNER_CAPACITY, keys + pos + 1);
+        std::copy(in->children, in->children + pos + 1, children);
+        children[pos + 1] = child;
+        std::copy(in->children + pos + 1, in->children + INNER_CAPACITY + 1, children + pos + 2);
+        inner *right = newNode<inner>();
+        unsigned half = (INNER_CAPACITY + 1) / 2;
+        std::move(keys, keys + half, in->keys);
+        std::copy(children, children + half + 1, in->children);
+        in->count = half;
+        up = std::move(keys[half]);
+        std::move(keys + half + 1, keys + INNER_CAPACITY + 1, right->keys);
+        std::copy(children + half + 1, children + INNER_CAPACITY + 2, right->children);
+        right->count = INNER_CAPACITY - half;
+        return right;
+    }
+
+    // Remove val under ptr, return true if ptr is less than half full afterwards
+    bool remove(node *ptr, const T &val) {
+        if (ptr->isLeaf){
+            leaf *lf = static_cast<leaf *>(ptr);
+            unsigned pos = lowerBound(lf->keys, lf->count, val);
+            if (pos == lf->count || val < lf->keys[pos]) return false;
+            std::move(lf->keys + pos + 1, lf->keys + lf->count, lf->keys + pos);
+            --lf->count;
+            --elements;
+            return lf->count < LEAF_MIN;
+        }
+        inner *in = static_cast<inner *>(ptr);
+        unsigned i = childIndex(in, val);
+        if (remove(in->children[i], val))
+            rebalance(in, i);
+        return in->count < INNER_MIN;
+    }
+
+    // children[i] of parent is less than half full: borrow from a sibling, or merge with it
+    void rebalance(inner *parent, unsigned i) {
+        node *child = parent->children[i];
+        node *left = i > 0 ? parent->children[i - 1] : nullptr;
+        node *right = i < parent->count ? parent->children[i + 1] : nullptr;
+        unsigned minimum = child->isLeaf ? LEAF_MIN : INNER_MIN;
+        if (left != nullptr && left->count > minimum){
+            borrowFromLeft(parent, i);
+        } else if (right != nullptr && right->count > minimum){
+            borrowFromRight(parent, i);
+        } else if (left != nullptr){
+            merge(parent, i - 1);
+        } else if (right != nullptr){
+            merge(parent, i);
+        }
+    }
+    void borrowFromLeft(inner *parent, unsigned i) {
+        if (parent->children[i]->isLeaf){
+            leaf *child = static_cast<leaf *>(parent->children[i]);
+            leaf *left = static_cast<leaf *>(parent->children[i - 1]);
+            std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+            child->keys[0] = std::move(left->keys[--left->count]);
+            ++child->count;
+            parent->keys[i - 1] = child->keys[0];
+        } else {
+            inner *child = static_cast<inner *>(parent->children[i]);
+            inner *left = static_cast<inner *>(parent->children[i - 1]);
+            std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+            std::move_backward(child->children, child->children + child->count + 1, child->children + child->count + 2);
+            child->keys[0] = std::move(parent->keys[i - 1]);
+            child->children[0] = left->children[left->count];
+            ++child->count;
+            parent->keys[i - 1] = std::move(left->keys[--left->count]);
+        }
+    }
+    void borrowFromRight(inner *parent, unsigned i) {
+        if (parent->children[i]->isLeaf){
+            leaf *child = static_cast<leaf *>(parent->children[i]);
+            leaf *right = static_cast<leaf *>(parent->children[i + 1]);
+            child->keys[child->count++] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            --right->count;
+            parent->keys[i] = right->keys[0];
+        } else {
+            inner *child = static_cast<inner *>(parent->children[i]);
+            inner *right = static_cast<inner *>(parent->children[i + 1]);
+            child->keys[child->count] = std::move(parent->keys[i]);
+            child->children[++child->count] = right->children[0];
+            parent->keys[i] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::copy(right->children + 1, right->children + right->count + 1, right->children);
+            --right->count;
+        }
+    }
+    // Merge children[i + 1] into children[i], separator keys[i] is removed from parent
+    void merge(inner *parent, unsigned i) {
+        if (parent->children[i]->isLeaf){
+            leaf *left = static_cast<leaf *>(parent->children[i]);
+            leaf *right = static_cast<leaf *>(parent->children[i + 1]);
+            std::move(right->keys, right->keys + right->count, left->keys + left->count);
+            left->count += right->count;
+            left->next = right->next;
+            if (right->next != nullptr) right->next->prev = left;
+            else tail = left;
+            deleteNode(right);
+        } else {
+            inner *left = static_cast<inner *>(parent->children[i]);
+            inner *right = static_cast<inner *>(parent->children[i + 1]);
+            left->keys[left->count] = std::move(parent->keys[i]);
+            std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+            std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+            left->count += right->count + 1;
+            deleteNode(right);
+        }
+        std::move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+        std::copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+        --parent->count;
+    }
+};
+
+
+//
+//  Epoch-based memory reclamation:
+//   1. Threads read shared nodes only inside a critical section (myEpochGuard), which announces the global epoch
+//      the thread entered in. Critical sections may nest.
+//   2. retire() puts an unlinked node in the limbo list of the current epoch instead of freeing it.
+//      The global epoch moves from e to e + 1 only when every thread inside a critical section has announced e,
+//      so once it reaches e + 2 no thread can still hold a node retired in e, and that limbo list is freed.
+//   3. Every thread takes a record on first use and gives it back on exit. Its limbo lists stay in the record
+//      and are freed by the next owner, or when the program exits.
+//   4. A thread stalled inside a critical section holds back reclamation, but never the progress of other threads.
+//
+class myEpochDomain {
+public:
+    static constexpr unsigned MAX_THREADS = 256;
+
+    static myEpochDomain &instance() {
+        static myEpochDomain domain;
+        return domain;
+    }
+    myEpochDomain(const myEpochDomain &) = delete;
+    myEpochDomain &operator=(const myEpochDomain &) = delete;
+    ~myEpochDomain() {
+        for (auto &rec : records)
+            for (auto &list : rec.limbo)
+                release(list);
+    }
+
+    void enter() {
+        record &rec = local();
+        if (rec.depth++ > 0) return;
+        rec.announce.store(epoch.load() << 1 | 1);
+        // The announcement is visible before any shared pointer is read
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    void exit() {
+        record &rec = local();
+        if (--rec.depth > 0) return;
+        rec.announce.store(0, std::memory_order_release);
+    }
+    // ptr is already unreachable for threads entering from now on, deleter(ptr) runs two epochs later
+    void retire(void *ptr, void (*deleter)(void *)) {
+        record &rec = local();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t e = epoch.load();
+        collect(rec, e);
+        rec.limbo[e % 3].push_back({ptr, deleter});
+        if (++rec.retiredSinceAdvance >= ADVANCE_PERIOD){
+            rec.retiredSinceAdvance = 0;
+            if (tryAdvance(e)) collect(rec, e + 1);
+        }
+    }
+    // Advance as far as possible and free what the calling thread can, e.g. at the end of a run
+    void synchronize() {
+        record &rec = local();
+        for (int i = 0; i < 2; ++i){
+            uint64_t e = epoch.load();
+            if (!tryAdvance(e)) break;
+            collect(rec, e + 1);
+        }
+    }
+
+    uint64_t currentEpoch() const {
+        return epoch.load(std::memory_order_relaxed);
+    }
+    // Number of retired pointers freed so far
+    uint64_t reclaimed() const {
+        return reclaimedCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Retired pointers between two advance attempts of one thread
+    static constexpr unsigned ADVANCE_PERIOD = 64;
+
+    struct retired {
+        void *ptr;
+        void (*deleter)(void *);
+    };
+    struct alignas(64) record {
+        std::atomic<uint64_t> announce{0};  // epoch << 1 | 1 inside a critical section, 0 outside
+        std::atomic<bool> owned{false};
+        unsigned depth = 0;
+        unsigned retiredSinceAdvance = 0;
+        uint64_t collected = 0;             // epoch of the last collect()
+        vector<retired> limbo[3];           // limbo[e % 3] holds the pointers retired in epoch e
+    };
+    // Gives the record back when its thread exits
+    struct handle {
+        record *rec = nullptr;
+        ~handle() {
+            if (rec != nullptr) rec->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    alignas(64) std::atomic<uint64_t> epoch{0};
+    std::atomic<unsigned> recordsUsed{0};
+    std::atomic<uint64_t> reclaimedCount{0};
+    record records[MAX_THREADS];
+
+    myEpochDomain() = default;
+
+    record &local() {
+        thread_local handle h;
+        if (h.rec == nullptr) h.rec = claim();
+        return *h.rec;
+    }
+    record *claim() {
+        while (true){
+            for (unsigned i = 0; i < MAX_THREADS; ++i){
+                bool expected = false;
+                if (records[i].owned.load(std::memory_order_relaxed) ||
+                    !records[i].owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    continue;
+                unsigned used = recordsUsed.load();
+                while (used < i + 1 && !recordsUsed.compare_exchange_weak(used, i + 1)) {}
+                return &records[i];
+            }
+            // More than MAX_THREADS threads, wait for one of them to exit
+            std::this_thread::yield();
+        }
+    }
+    bool tryAdvance(uint64_t e) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        unsigned used = recordsUsed.load();
+        for (unsigned i = 0; i < used; ++i){
+            uint64_t announce = records[i].announce.load();
+            if ((announce & 1) && (announce >> 1) != e) return false;
+        }
+        return epoch.compare_exchange_strong(e, e + 1);
+    }
+    // The global epoch is e: pointers retired in e - 2 or before share limbo[(e + 1) % 3]
+    void collect(record &rec, uint64_t e) {
+        if (rec.collected == e) return;
+        rec.collected = e;
+        release(rec.limbo[(e + 1) % 3]);
+    }
+    void release(vector<retired> &list) {
+        for (auto &r : list)
+            r.deleter(r.ptr);
+        reclaimedCount.fetch_add(list.size(), std::memory_order_relaxed);
+        list.clear();
+    }
+};
+
+// RAII critical section of myEpochDomain
+class myEpochGuard {
+public:
+    myEpochGuard() {
+        myEpochDomain::instance().enter();
+    }
+    ~myEpochGuard() {
+        myEpochDomain::instance().exit();
+    }
+    myEpochGuard(const myEpochGuard &) = delete;
+    myEpochGuard &operator=(const myEpochGuard &) = delete;
+};
+
+
+//
+//  Concurrent Skip List:
+//   1. A thread-safe ordered set. All member functions may run concurrently, except clear(), copy, move, swap
+//      and destruction. Same surface as myAVLTree: insert / remove / contain / min / max / forEach.
+//   2. Lock-free (Harris, Herlihy-Shavit): remove() marks the low bit of the next pointers of a node from the top
+//      level down, and the thread that marks level 0 owns the removal. Searches snip marked nodes with CAS.
+//      insert() links level 0 with one CAS (the node is in the set from then on), then the upper levels.
+//   3. contain() never writes shared memory, it steps over marked nodes instead of snipping them.
+//   4. Removed nodes are retired to myEpochDomain and every operation runs inside a myEpochGuard,
+//      so a node is only freed after all threads which might still read it have left their critical section.
+//      A node is retired only when both its inserter has finished linking the tower and its remover has marked it.
+//      Whichever of them finishes last snips the node at every level and retires it, so a retired node
+//      can never be linked again.
+//   5. Towers are allocated with exactly their height, heights are geometric with p = 1/2 up to MAX_LEVEL.
+//   6. insert() and remove() return whether the set changed. size() is exact only when no other thread runs,
+//      min(), max() and forEach() see every node consistently but not a snapshot of the whole set.
+//
+template <typename T>
+class myConcurrentSkipList {
+public:
+    static constexpr int MAX_LEVEL = 24;
+
+    myConcurrentSkipList(): head(newNode(T(), MAX_LEVEL)) {}
+    myConcurrentSkipList(const myConcurrentSkipList &rhs): myConcurrentSkipList() {
+        rhs.forEach([this](const T &val){ insert(val); });
+    }
+    myConcurrentSkipList(myConcurrentSkipList &&rhs): myConcurrentSkipList() {
+        swap(rhs);
+    }
+    myConcurrentSkipList &operator=(myConcurrentSkipList rhs) {
+        swap(rhs);
+        return *this;
+    }
+    ~myConcurrentSkipList() {
+        clear();
+        deleteNode(head);
+    }
+    void swap(myConcurrentSkipList &rhs) {
+        std::swap(head, rhs.head);
+        int64_t n = count.load();
+        count.store(rhs.count.load());
+        rhs.count.store(n);
+    }
+
+    // Not thread-safe, no other operation may run at the same time.
+    void clear() {
+        node *curr = ptrOf(head->next()[0].load());
+        while (curr != nullptr){
+            node *next = ptrOf(curr->next()[0].load());
+            deleteNode(curr);
+            curr = next;
+        }
+        for (int i = 0; i < MAX_LEVEL; ++i)
+            head->next()[i].store(0);
+        count.store(0);
+    }
+    bool empty() const {
+        myEpochGuard guard;
+        return first() == nullptr;
+    }
+    size_t size() const {
+        return static_cast<size_t>(std::max<int64_t>(count.load(std::memory_order_relaxed), 0));
+    }
+    // Index of the highest non-empty level, -1 for empty list, the same convention as the trees
+    int getHeight() const {
+        int height = MAX_LEVEL;
+        while (height > 0 && ptrOf(head->next()[height - 1].load(std::memory_order_acquire)) == nullptr)
+            --height;
+        return height - 1;
+    }
+
+    T min() const {
+        myEpochGuard guard;
+        node *minNode = first();
+        if (minNode == nullptr){
+            cerr << "Error: cannot get the minimum of empty skip list." << endl;
+            return {};
+        }
+        return minNode->value;
+    }
+    // Walk down from the top level, keep the last node not being removed
+    T max() const {
+        myEpochGuard guard;
+        node *pred = head;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i){
+            node *curr = ptrOf(pred->next()[i].load(std::memory_order_acquire));
+            while (curr != nullptr){
+                uintptr_t succ = curr->next()[i].load(std::memory_order_acquire);
+                if (!marked(succ)) pred = curr;
+                curr = ptrOf(succ);
+            }
+        }
+        if (pred == head){
+            cerr << "Error: cannot get the maximum of empty skip list." << endl;
+            return {};
+        }
+        return pred->value;
+    }
+
+    bool contain(const T &val) const {
+        PTIME_SCOPE("myConcurrentSkipList::contain");
+        myEpochGuard guard;
+        node *pred = head, *curr = nullptr;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i){
+            curr = ptrOf(pred->next()[i].load(std::memory_order_acquire));
+            while (curr != nullptr){
+                uintptr_t succ = curr->next()[i].load(std::memory_order_acquire);
+                if (!marked(succ)){
+                    if (!(curr->value < val)) break;
+                    pred = curr;
+                }
+                curr = ptrOf(succ);
+            }
+        }
+        return curr != nullptr && !(val < curr->value);
+    }
+    bool insert(const T &val) {
+        PTIME_SCOPE("myConcurrentSkipList::insert");
+        return insertNode(val);
+    }
+    bool insert(T &&val) {
+        PTIME_SCOPE("myConcurrentSkipList::insert");
+        return insertNode(std::move(val));
+    }
+    bool remove(const T &val) {
+        PTIME_SCOPE("myConcurrentSkipList::remove");
+        myEpochGuard guard;
+        node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+        if (!find(val, preds, succs)) return false;
+        node *victim = succs[0];
+        for (int i = victim->level - 1; i > 0; --i)
+            victim->next()[i].fetch_or(1);
+        // Another thread marked level 0 first and owns the removal
+        if (marked(victim->next()[0].fetch_or(1))) return false;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        release(victim);
+        return true;
+    }
+    // Visit values in ascending order. The critical section lasts for the whole walk.
+    template <typename Func>
+    void forEach(const Func &func) const {
+        myEpochGuard guard;
+        node *curr = ptrOf(head->next()[0].load(std::memory_order_acquire));
+        while (curr != nullptr){
+            uintptr_t succ = curr->next()[0].load(std::memory_order_acquire);
+            if (!marked(succ)) func(curr->value);
+            curr = ptrOf(succ);
+        }
+    }
+
+private:
+    // The tower of next pointers follows the node in the same block. The low bit of a next pointer marks
+    // the node itself (not the successor) as removed at that level.
+    struct alignas(alignof(std::atomic<uintptr_t>)) node {
+        T value;
+        int level;
+        // The inserter and the remover, see release()
+        std::atomic<int> owners{2};
+        template <typename V>
+        node(V &&val, int l): value(std::forward<V>(val)), level(l) {}
+        std::atomic<uintptr_t> *next() {
+            return reinterpret_cast<std::atomic<uintptr_t> *>(this + 1);
+        }
+    };
+    node *head;
+    std::atomic<int64_t> count{0};
+
+    static node *ptrOf(uintptr_t word) {
+        return reinterpret_cast<node *>(word & ~uintptr_t(1));
+    }
+    static bool marked(uintptr_t word) {
+        return word & 1;
+    }
+    static uintptr_t word(node *ptr) {
+        return reinterpret_cast<uintptr_t>(ptr);
+    }
+    template <typename V>
+    static node *newNode(V &&val, int level) {
+        void *block = ::operator new(sizeof(node) + level * sizeof(std::atomic<uintptr_t>));
+        node *ptr = ::new (block) node(std::forward<V>(val), level);
+        for (int i = 0; i < level; ++i)
+            ::new (static_cast<void *>(ptr->next() + i)) std::atomic<uintptr_t>(0);
+        return ptr;
+    }
+    static void deleteNode(void *block) {
+        static_cast<node *>(block)->~node();
+        ::operator delete(block);
+    }
+    // Geometric height from a per thread xorshift generator
+    static int randomLevel() {
+        thread_local uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return 1 + __builtin_ctzll(state | (uint64_t(1) << (MAX_LEVEL - 1)));
+    }
+
+    // First node of level 0 which is not being removed, called inside a critical section
+    node *first() const {
+        node *curr = ptrOf(head->next()[0].load(std::memory_order_acquire));
+        while (curr != nullptr){
+            uintptr_t succ = curr->next()[0].load(std::memory_order_acquire);
+            if (!marked(succ)) return curr;
+            curr = ptrOf(succ);
+        }
+        return nullptr;
+    }
+
+    // Fill preds and succs of every level around val, snipping marked nodes on the way.
+    // A failed snip means pred changed under us, and the search starts again from the head.
+    // Return whether succs[0] holds val.
+    bool find(const T &val, node **preds, node **succs) {
+        while (true){
+            bool consistent = true;
+            node *pred = head;
+            for (int i = MAX_LEVEL - 1; i >= 0 && consistent; --i){
+                node *curr = ptrOf(pred->next()[i].load());
+                while (curr != nullptr){
+                    uintptr_t succ = curr->next()[i].load();
+                    if (marked(succ)){
+                        uintptr_t expected = word(curr);
+                        if (!pred->next()[i].compare_exchange_strong(expected, succ & ~uintptr_t(1))){
+                            consistent = false;
+                            break;
+                        }
+                        curr = ptrOf(succ);
+                    } else if (curr->value < val){
+                        pred = curr;
+                        curr = ptrOf(succ);
+                    } else {
+                        break;
+                    }
+                }
+                preds[i] = pred;
+                succs[i] = curr;
+            }
+            if (consistent)
+                return succs[0] != nullptr && !(val < succs[0]->value);
+        }
+    }
+
+    template <typename V>
+    bool insertNode(V &&val) {
+        myEpochGuard guard;
+        node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+        if (find(val, preds, succs)) return false;
+        node *ptr = newNode(std::forward<V>(val), randomLevel());
+        while (true){
+            for (int i = 0; i < ptr->level; ++i)
+                ptr->next()[i].store(word(succs[i]), std::memory_order_relaxed);
+            uintptr_t expected = word(succs[0]);
+            if (preds[0]->next()[0].compare_exchange_strong(expected, word(ptr))) break;
+            // Not published yet, so it can be freed at once
+            if (find(ptr->value, preds, succs)){
+                deleteNode(ptr);
+                return false;
+            }
+        }
+        count.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 1; i < ptr->level && linkLevel(ptr, i, preds, succs); ++i) {}
+        release(ptr);
+        return true;
+    }
+    // Called once by the inserter when the tower is linked and once by the remover when the node is marked.
+    // The last of the two snips the node at every level (no level can be linked after that) and retires it.
+    void release(node *ptr) {
+        if (ptr->owners.fetch_sub(1) != 1) return;
+        node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+        find(ptr->value, preds, succs);
+        myEpochDomain::instance().retire(ptr, deleteNode);
+    }
+    // Link level i of a new node, false when it is being removed
+    bool linkLevel(node *ptr, int i, node **preds, node **succs) {
+        while (true){
+            uintptr_t next = ptr->next()[i].load();
+            if (marked(next)) return false;
+            // Only a remover changes the upper levels of an unlinked node, so a failed CAS means a mark
+            if (next != word(succs[i]) && !ptr->next()[i].compare_exchange_strong(next, word(succs[i]))) return false;
+            uintptr_t expected = word(succs[i]);
+            if (preds[i]->next()[i].compare_exchange_strong(expected, word(ptr))) return true;
+            find(ptr->value, preds, succs);
+            if (succs[0] != ptr) return false;
+        }
+    }
+};
+
+
+//
+//  Lock-based baseline of a concurrent tree: any tree of this file behind one std::mutex.
+//  Use it in myTreeBenchmarkConcurrent through an alias template, e.g.
+//      template <typename T> using lockedAVL = myLockedTree<myAVLTree<T>>;
+//  A reader-writer lock would not help mySplayTree, which restructures itself on contain().
+//
+template <typename Tree>
+class myLockedTree {
+public:
+    using valueType = std::decay_t<decltype(std::declval<Tree &>().min())>;
+
+    void insert(const valueType &val) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tree.insert(val);
+    }
+    void remove(const valueType &val) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tree.remove(val);
+    }
+    bool contain(const valueType &val) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tree.contain(val);
+    }
+    valueType min() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tree.min();
+    }
+    valueType max() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tree.max();
+    }
+    bool empty() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return tree.empty();
+    }
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx);
+        tree.clear();
+    }
+    template <typename Func>
+    void forEach(const Func &func) {
+        std::lock_guard<std::mutex> lock(mtx);
+        tree.forEach(func);
+    }
+private:
+    std::mutex mtx;
+    Tree tree;
+};
+
+
+// std allocator returning 64-byte aligned storage, so element k * 64 / sizeof(T) starts a cache line.
+template <typename T>
+class myCacheLineAllocator {
+public:
+    using value_type = T;
+    static constexpr size_t ALIGN = 64;
+
+    myCacheLineAllocator() = default;
+    template <typename U>
+    myCacheLineAllocator(const myCacheLineAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(ALIGN)));
+    }
+    void deallocate(T *ptr, size_t) {
+        ::operator delete(ptr, std::align_val_t(ALIGN));
+    }
+    template <typename U>
+    bool operator==(const myCacheLineAllocator<U> &) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const myCacheLineAllocator<U> &) const {
+        return false;
+    }
+};
+
+
+//
+// Static Search Tree:
+//  1. Immutable, pointer-free search tree over sorted distinct values, built once and queried many times.
+//  2. Layouts:
+//      "Eytzinger" - BFS order, children of position k are 2k and 2k + 1. Search prefetches the cache line
+//                    four levels ahead, so the next levels are in flight while the current one is compared.
+//      "vEB"       - van Emde Boas order: the tree is cut at half height, the top tree is stored first, then each
+//                    bottom tree, recursively. Any root-to-leaf path touches O(log_B n) cache lines for every B.
+//                    The tree is padded to a perfect one with copies of the maximum.
+//  3. lowerBound() is branchless: every level does k = 2k + (value < x), the answer is found from the final k.
+//  4. lowerBoundBatch() runs GROUP searches in lock step, so the memory latency of one is hidden by the others.
+//  5. myFreeze() builds one from any tree with forEach() (myBST, myAVLTree, mySplayTree, myBPlusTree).
+//
+template <typename T>
+class myStaticSearchTree {
+public:
+    static constexpr unsigned GROUP = 16;
+
+    myStaticSearchTree() = default;
+    // sorted should be ascending without repeat values
+    explicit myStaticSearchTree(const vector<T> &sorted, string layout = "Eytzinger") {
+        if (layout != "Eytzinger" && layout != "vEB"){
+            cerr << "Error: unknown static tree layout " << layout << "." << endl;
+            return;
+        }
+        veb = layout == "vEB";
+        elements = sorted.size();
+        if (elements == 0) return;
+        minValue = sorted.front();
+        maxValue = sorted.back();
+        if (!veb){
+            values.resize(elements + 1);
+            size_t next = 0;
+            buildEytzinger(sorted, next, 1);
+            return;
+        }
+        // Perfect tree of height levels, padded with the maximum
+        levels = 1;
+        while (((size_t(1) << levels) - 1) < elements) ++levels;
+        size_t n = (size_t(1) << levels) - 1;
+        vector<T> bfs(n + 1, sorted.back());
+        size_t next = 0;
+        buildEytzinger(sorted, next, 1, bfs, n);
+        values.reserve(n);
+        buildVeb(bfs, 1, levels);
+        topSize.assign(levels, 0);
+        bottomSize.assign(levels, 0);
+        topDepth.assign(levels, 0);
+        vebTables(0, levels);
+    }
+
+    size_t size() const {
+        return elements;
+    }
+    bool empty() const {
+        return elements == 0;
+    }
+    string layout() const {
+        return veb ? "vEB" : "Eytzinger";
+    }
+    T min() const {
+        if (empty()){
+            cerr << "Error: cannot get the minimum of empty tree." << endl;
+            return {};
+        }
+        return minValue;
+    }
+    T max() const {
+        if (empty()){
+            cerr << "Error: cannot get the maximum of empty tree." << endl;
+            return {};
+        }
+        return maxValue;
+    }
+
+    // Smallest value not less than x, nullptr if there is none
+    const T *lowerBound(const T &x) const {
+        if (empty()) return nullptr;
+        return veb ? lowerBoundVeb(x) : lowerBoundEytzinger(x);
+    }
+    bool contain(const T &x) const {
+        const T *ptr = lowerBound(x);
+        return ptr != nullptr && !(x < *ptr);
+    }
+    // results[i] = lowerBound(queries[i]), searches are interleaved in groups
+    void lowerBoundBatch(const T *queries, size_t count, const T **results) const {
+        for (size_t begin = 0; begin < count; begin += GROUP){
+            size_t group = std::min<size_t>(GROUP, count - begin);
+            if (empty()){
+                std::fill(results + begin, results + begin + group, nullptr);
+            } else if (veb){
+                batchVeb(queries + begin, group, results + begin);
+            } else {
+                batchEytzinger(queries + begin, group, results + begin);
+            }
+        }
+    }
+    vector<const T *> lowerBoundBatch(const vector<T> &queries) const {
+        vector<const T *> results(queries.size());
+        lowerBoundBatch(queries.data(), queries.size(), results.data());
+        return results;
+    }
+
+private:
+    // Eytzinger: values[1, elements]. vEB: values[0, 2^levels - 1). Cache line aligned for the prefetch.
+    vector<T, myCacheLineAllocator<T>> values;
+    size_t elements = 0;
+    bool veb = false;
+    unsigned levels = 0;
+    T minValue{}, maxValue{};
+    // vEB navigation, for every depth d: size of the top tree and of the bottom trees of the cut above d,
+    // and depth of the root of that top tree. Only set for depths which start a bottom tree.
+    vector<size_t> topSize, bottomSize;
+    vector<unsigned> topDepth;
+
+    // Elements per cache line, the prefetch of k * LINE is the first child of k four levels down (for 4-byte T)
+    static constexpr size_t LINE = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+    static void prefetch(const T *base, size_t k) {
+        __builtin_prefetch(reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(base) + k * LINE * sizeof(T)));
+    }
+
+    // In-order fill of BFS positions
+    void buildEytzinger(const vector<T> &sorted, size_t &next, size_t k) {
+        if (k > elements) return;
+        buildEytzinger(sorted, next, 2 * k);
+        values[k] = sorted[next++];
+        buildEytzinger(sorted, next, 2 * k + 1);
+    }
+    void buildEytzinger(const vector<T> &sorted, size_t &next, size_t k, vector<T> &bfs, size_t n) {
+        if (k > n) return;
+        buildEytzinger(sorted, next, 2 * k, bfs, n);
+        if (next < sorted.size()) bfs[k] = sorted[next++];
+        buildEytzinger(sorted, next, 2 * k + 1, bfs, n);
+    }
+    // vEB order of the subtree of BFS position root with the given height
+    void buildVeb(const vector<T> &bfs, size_t root, unsigned height) {
+        if (height == 1){
+            values.push_back(bfs[root]);
+            return;
+        }
+        unsigned top = height / 2, bottom = height - top;
+        buildVeb(bfs, root, top);
+        for (size_t j = 0; j < (size_t(1) << top); ++j)
+            buildVeb(bfs, (root << top) | j, bottom);
+    }
+    void vebTables(unsigned depth, unsigned height) {
+        if (height == 1) return;
+        unsigned top = height / 2, bottom = height - top;
+        topSize[depth + top] = (size_t(1) << top) - 1;
+        bottomSize[depth + top] = (size_t(1) << bottom) - 1;
+        topDepth[depth + top] = depth;
+        vebTables(depth, top);
+        vebTables(depth + top, bottom);
+    }
+
+    // After the descent k is past a leaf. The answer is where the path last went left:
+    // drop the trailing 1 bits (right turns) and one more bit.
+    static size_t answer(size_t k) {
+        return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+    }
+
+    const T *lowerBoundEytzinger(const T &x) const {
+        const T *base = values.data();
+        size_t k = 1;
+        while (k <= elements){
+            prefetch(base, k);
+            k = 2 * k + (base[k] < x);
+        }
+        k = answer(k);
+        return k == 0 ? nullptr : base + k;
+    }
+    const T *lowerBoundVeb(const T &x) const {
+        const T *base = values.data();
+        size_t pos[64];
+        size_t k = 1;
+        pos[0] = 0;
+        for (unsigned d = 0; d < levels; ++d){
+            k = 2 * k + (base[pos[d]] < x);
+            if (d + 1 < levels)
+                pos[d + 1] = pos[topDepth[d + 1]] + topSize[d + 1] + (k & topSize[d + 1]) * bottomSize[d + 1];
+        }
+        k = answer(k);
+        if (k == 0) return nullptr;
+        // Depth of the answer on the path
+        return base + pos[63 - __builtin_clzll(k)];
+    }
+
+    void batchEytzinger(const T *queries, size_t group, const T **results) const {
+        const T *base = values.data();
+        size_t k[GROUP];
+        std::fill(k, k + group, 1);
+        // Full depth of the tree, the last level may be partly missing
+        unsigned depth = 64 - __builtin_clzll(elements);
+        for (unsigned d = 0; d < depth; ++d){
+            for (size_t j = 0; j < group; ++j){
+                if (k[j] > elements) continue;
+                prefetch(base, k[j]);
+                k[j] = 2 * k[j] + (base[k[j]] < queries[j]);
+            }
+        }
+        for (size_t j = 0; j < group; ++j){
+            size_t a = answer(k[j]);
+            results[j] = a == 0 ? nullptr : base + a;
+        }
+    }
+    void batchVeb(const T *queries, size_t group, const T **results) const {
+        const T *base = values.data();
+        size_t k[GROUP];
+        size_t pos[GROUP][64];
+        for (size_t j = 0; j < group; ++j){
+            k[j] = 1;
+            pos[j][0] = 0;
+        }
+        for (unsigned d = 0; d < levels; ++d){
+            for (size_t j = 0; j < group; ++j){
+                k[j] = 2 * k[j] + (base[pos[j][d]] < queries[j]);
+                if (d + 1 < levels){
+                    size_t next = pos[j][topDepth[d + 1]] + topSize[d + 1] + (k[j] & topSize[d + 1]) * bottomSize[d + 1];
+                    pos[j][d + 1] = next;
+                    __builtin_prefetch(base + next);
+                }
+            }
+        }
+        for (size_t j = 0; j < group; ++j){
+            size_t a = answer(k[j]);
+            results[j] = a == 0 ? nullptr : base + pos[j][63 - __builtin_clzll(a)];
+        }
     }
+};
 
-    // single rotate routine (the same as AVL tree implementation)
-    // and no need to update height !
-    void rotateLeft(node *&ptr){
-        node *newPtr = ptr->left;
-        ptr->left = newPtr->right;
-        newPtr->right = ptr;
-        ptr = newPtr;
+//
+//  Freeze a tree into a myStaticSearchTree, layout = "Eytzinger" or "vEB".
+//  The tree only needs forEach() visiting values in ascending order.
+//
+template <typename Tree>
+auto myFreeze(const Tree &tree, string layout = "Eytzinger") {
+    using T = std::decay_t<decltype(std::declval<Tree &>().min())>;
+    vector<T> sorted;
+    tree.forEach([&sorted](const T &val){ sorted.push_back(val); });
+    return myStaticSearchTree<T>(sorted, layout);
+}
 
-    }
-    void rotateRight(node *&ptr){
-        node *newPtr = ptr->right;
-        ptr->right = newPtr->left;
-        newPtr->left = ptr;
-        ptr = newPtr;
-    }
-    node *root = nullptr;
+
+//
+//  Static search tree benchmark:
+//   Lookups of config.queries uniform keys among config.elements keys (half of them hit), median of config.repeats runs.
+//   Cases: myAVLTree::contain, std::lower_bound over the sorted vector, and both layouts of myStaticSearchTree
+//   with single and batch lower bound.
+//
+struct staticTreeBenchConfig {
+    unsigned elements = 1 << 22;
+    unsigned queries = 1 << 22;
+    unsigned repeats = 3;
+};
+
+struct staticTreeBenchResult {
+    string name;
+    unsigned elements = 0;
+    unsigned queries = 0;
+    unsigned found = 0;
+    pStats ns;
+    double nsPerQuery = 0;
 };
 
+vector<staticTreeBenchResult> staticTreeBenchmark(const staticTreeBenchConfig &config = staticTreeBenchConfig()) {
+    vector<staticTreeBenchResult> results;
+    vector<int> sorted(config.elements);
+    for (unsigned i = 0; i < config.elements; ++i)
+        sorted[i] = 2 * i;
+    std::mt19937 gen(2021);
+    std::uniform_int_distribution<int> dist(0, std::max(2 * static_cast<int>(config.elements) - 1, 0));
+    vector<int> queries(config.queries);
+    for (auto &q : queries)
+        q = dist(gen);
+    myAVLTree<int> avl;
+    for (auto x : sorted)
+        avl.insert(x);
+    myStaticSearchTree<int> eytzinger(sorted, "Eytzinger"), veb(sorted, "vEB");
+    vector<const int *> out(config.queries);
+    auto hits = [&](){
+        unsigned found = 0;
+        for (size_t i = 0; i < queries.size(); ++i)
+            found += out[i] != nullptr && *out[i] == queries[i];
+        return found;
+    };
+    vector<std::pair<string, std::function<void()>>> cases{
+        {"AVL contain", [&]{
+            for (size_t i = 0; i < queries.size(); ++i) out[i] = avl.contain(queries[i]) ? &queries[i] : nullptr;
+        }},
+        {"std::lower_bound", [&]{
+            for (size_t i = 0; i < queries.size(); ++i){
+                auto it = std::lower_bound(sorted.begin(), sorted.end(), queries[i]);
+                out[i] = it == sorted.end() ? nullptr : &*it;
+            }
+        }},
+        {"Eytzinger", [&]{
+            for (size_t i = 0; i < queries.size(); ++i) out[i] = eytzinger.lowerBound(queries[i]);
+        }},
+        {"Eytzinger batch", [&]{
+            eytzinger.lowerBoundBatch(queries.data(), queries.size(), out.data());
+        }},
+        {"vEB", [&]{
+            for (size_t i = 0; i < queries.size(); ++i) out[i] = veb.lowerBound(queries[i]);
+        }},
+        {"vEB batch", [&]{
+            veb.lowerBoundBatch(queries.data(), queries.size(), out.data());
+        }},
+    };
+    for (auto &c : cases){
+        staticTreeBenchResult res;
+        res.name = c.first;
+        res.elements = config.elements;
+        res.queries = config.queries;
+        vector<double> ns;
+        for (unsigned r = 0; r < std::max(config.repeats, 1u); ++r){
+            auto begin = std::chrono::steady_clock::now();
+            c.second();
+            ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+        }
+        res.found = hits();
+        res.ns = pStats::of(ns);
+        res.nsPerQuery = res.ns.median / std::max(config.queries, 1u);
+        if (!results.empty() && res.found != results.front().found)
+            cerr << "Error: " << res.name << " found " << res.found << " keys instead of " << results.front().found << "." << endl;
+        results.push_back(res);
+    }
+    return results;
+}
+
+void staticTreeBenchReport(const vector<staticTreeBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(18) << "case" << std::right << std::setw(11) << "elements" << std::setw(11) << "queries"
+           << std::setw(11) << "found" << std::setw(14) << "median ms" << std::setw(12) << "ns/query" << endl;
+        for (auto &r : results)
+            os << std::left << std::setw(18) << r.name << std::right << std::setw(11) << r.elements << std::setw(11) << r.queries
+               << std::setw(11) << r.found << std::setw(14) << r.ns.median / 1e6 << std::setw(12) << r.nsPerQuery << endl;
+    } else if (mode == "CSV"){
+        os << "case,elements,queries,found,median_ns,p95_ns,ns_per_query" << endl;
+        for (auto &r : results)
+            os << r.name << "," << r.elements << "," << r.queries << "," << r.found << "," << r.ns.median << "," << r.ns.p95
+               << "," << r.nsPerQuery << endl;
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"case\": \"" << r.name << "\", \"elements\": " << r.elements << ", \"queries\": " << r.queries
+               << ", \"found\": " << r.found << ", \"median_ns\": " << r.ns.median << ", \"p95_ns\": " << r.ns.p95
+               << ", \"ns_per_query\": " << r.nsPerQuery << "}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
+}
+
 
 //
 //  A routine to evaluate the performance of a tree structure.
 //   1. Using pTime routine to measure the time it cost for a tree structure to finish a fixed process.
 //   2. inputNum is the number of random integers input.
+//   3. Non-interactive, see myTreeBenchmark for mixed workloads.
 //
 template <template<typename U> typename treeTemplate>
 void myTreeEvaluator(unsigned inputNum = 100, unsigned accessNum = 100, std::string inputMode = "Random", std::string accessMode = "Random") {
     cout << "Notice: template should support int type element and repeat insertion." << endl;
-    cout << "Press ENTER to continue if you are sure about your template." << endl;
-    string cont;
-    getline(cin, cont);
     pTime pt;
-    std::random_device rd;
+    std::mt19937 gen(2021);
     treeTemplate<int> tree;
     for (auto i = 0; i < inputNum; ++i){
         if (inputMode == "Random")
-            tree.insert(rd());
+            tree.insert(static_cast<int>(gen()));
         else if (inputMode == "Sequential")
             tree.insert(i + 1); 
     }
     auto maxVal = tree.max(), minVal = tree.min();
-    pt.start();
-    for (auto i = 0; i < accessNum; ++i){
+    // Draw keys before timing, so only the accesses are counted.
+    vector<int> keys(accessNum);
+    for (auto &key : keys){
         if (accessMode == "Random")
-            tree.contain(rd());
+            key = static_cast<int>(gen());
         else if (accessMode == "Sequential")
-            tree.contain((maxVal+minVal)/2 + 1);
+            key = minVal/2 + maxVal/2 + 1;
     }
+    unsigned found = 0;
+    pt.start();
+    for (auto key : keys)
+        found += tree.contain(key);
     pt.end();        
-    cout << "Total time for " << accessNum << " accesses: " << pt.duration() << " ms" << endl;
-    cout << "Mean access time: " << pt.duration()*1.0 / accessNum << " ms" << endl;
+    cout << "Total time for " << accessNum << " accesses: " << pt.durationNs() / 1e6 << " ms (" << found << " found)" << endl;
+    cout << "Mean access time: " << pt.durationNs()*1.0 / accessNum << " ns" << endl;
+}
+
+
+//
+//  Tree workload benchmark:
+//   1. Non-interactive. Runs a mixed insert / contain / remove workload with configurable ratios.
+//   2. Key distributions of the workload:
+//       "Uniform"       - every key of [0, keySpace) is equally likely.
+//       "Zipfian"       - key of rank i is drawn with probability proportional to 1 / i^zipfTheta.
+//       "HotSet"        - hotProbability of the accesses go to a hot set of hotFraction of the key space.
+//       "SlidingWindow" - uniform inside a window of windowSize keys, which slides over the key space during the run.
+//   3. Every operation is timed by steady_clock, the result has ops/sec and latency percentiles in ns.
+//   4. Template should support int type element, tolerate repeat insertion and removal of missing keys.
+//
+
+// Workload description of myTreeBenchmark
+struct treeWorkload {
+    unsigned keySpace = 1000000;    // keys are drawn from [0, keySpace)
+    unsigned preload = 100000;      // uniform keys inserted before measuring
+    unsigned operations = 1000000;
+    double insertRatio = 0.1;       // the rest of insert and remove are contain
+    double removeRatio = 0.1;
+    string distribution = "Uniform";
+    double zipfTheta = 0.99;
+    double hotFraction = 0.01;
+    double hotProbability = 0.9;
+    unsigned windowSize = 10000;
+    unsigned seed = 2021;
+    // Replay the workload on a second tree with pCounters and without per operation timing
+    bool counters = false;
+};
+
+//
+// Key generator of treeWorkload.
+//  Zipfian keys use the rejection-free method of Gray et al. (the one used in YCSB), which needs 0 < zipfTheta < 1.
+//
+class treeKeyGenerator {
+public:
+    explicit treeKeyGenerator(const treeWorkload &w):
+        work(w), gen(w.seed), uniform(0, w.keySpace - 1) {
+        if (work.distribution == "Zipfian" && !(work.zipfTheta > 0 && work.zipfTheta < 1)){
+            cerr << "Error: zipfTheta should be in (0, 1), use Uniform instead." << endl;
+        } else if (work.distribution == "Zipfian"){
+            zipfian = true;
+            double theta = work.zipfTheta;
+            for (unsigned i = 1; i <= work.keySpace; ++i)
+                zetaN += 1.0 / std::pow(i, theta);
+            double zeta2 = 1 + 1.0 / std::pow(2, theta);
+            alpha = 1 / (1 - theta);
+            eta = (1 - std::pow(2.0 / work.keySpace, 1 - theta)) / (1 - zeta2 / zetaN);
+        } else if (work.distribution != "Uniform" && work.distribution != "HotSet" && work.distribution != "SlidingWindow"){
+            cerr << "Error: unknown key distribution " << work.distribution << "." << endl;
+        }
+    }
+    // Key of the i-th operation
+    int next(unsigned i) {
+        if (zipfian){
+            double u = real(gen), uz = u * zetaN;
+            if (uz < 1) return 0;
+            if (uz < 1 + std::pow(0.5, work.zipfTheta)) return 1;
+            auto key = static_cast<unsigned>(work.keySpace * std::pow(eta * u - eta + 1, alpha));
+            return std::min(key, work.keySpace - 1);
+        } else if (work.distribution == "HotSet"){
+            unsigned hotSize = std::max(1u, static_cast<unsigned>(work.keySpace * work.hotFraction));
+            if (real(gen) < work.hotProbability) return gen() % hotSize;
+            return hotSize + gen() % std::max(1u, work.keySpace - hotSize);
+        } else if (work.distribution == "SlidingWindow"){
+            unsigned window = std::max(1u, std::min(work.windowSize, work.keySpace));
+            unsigned start = static_cast<unsigned>((work.keySpace - window) * 1.0 * i / std::max(1u, work.operations));
+            return start + gen() % window;
+        }
+        return uniform(gen);
+    }
+    int nextUniform() {
+        return uniform(gen);
+    }
+    double nextReal() {
+        return real(gen);
+    }
+private:
+    const treeWorkload &work;
+    std::mt19937 gen;
+    std::uniform_int_distribution<int> uniform;
+    std::uniform_real_distribution<double> real{0, 1};
+    bool zipfian = false;
+    double zetaN = 0, alpha = 0, eta = 0;
+};
+
+// Result of myTreeBenchmark
+struct treeBenchResult {
+    string tree;
+    string distribution;
+    unsigned operations = 0;
+    unsigned found = 0;         // successful contain, keeps the lookups from being optimized away
+    double seconds = 0;
+    double opsPerSec = 0;
+    pStats insertNs;
+    pStats containNs;
+    pStats removeNs;
+    pStats allNs;
+    // Allocation statistics after the run, only filled when the tree has allocStats() and MYDSA_ALLOC_STATS is defined.
+    myAllocStats alloc;
+    double bytesPerElement = 0;
+    // pCounters values of the whole replayed workload, -1 if not measured
+    pCounters::sample counters = pCounters::sample{{-1, -1, -1, -1, -1, -1}};
+};
+
+template <template<typename U> typename treeTemplate>
+treeBenchResult myTreeBenchmark(const treeWorkload &work = treeWorkload(), string name = "tree") {
+    treeTemplate<int> tree;
+    treeKeyGenerator keys(work);
+    vector<int> preload(work.preload);
+    for (auto &key : preload)
+        key = keys.nextUniform();
+    for (auto key : preload)
+        tree.insert(key);
+    // Draw the whole operation sequence before timing
+    enum struct opType {INSERT, CONTAIN, REMOVE};
+    vector<std::pair<opType, int>> ops(work.operations);
+    for (unsigned i = 0; i < work.operations; ++i){
+        double r = keys.nextReal();
+        opType op = r < work.insertRatio ? opType::INSERT
+                  : r < work.insertRatio + work.removeRatio ? opType::REMOVE : opType::CONTAIN;
+        ops[i] = {op, keys.next(i)};
+    }
+    treeBenchResult result;
+    result.tree = name;
+    result.distribution = work.distribution;
+    result.operations = work.operations;
+    vector<double> insertNs, containNs, removeNs, allNs;
+    allNs.reserve(work.operations);
+    auto runBegin = std::chrono::steady_clock::now();
+    for (auto &op : ops){
+        auto begin = std::chrono::steady_clock::now();
+        if (op.first == opType::INSERT)
+            tree.insert(op.second);
+        else if (op.first == opType::REMOVE)
+            tree.remove(op.second);
+        else
+            result.found += tree.contain(op.second);
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        allNs.push_back(ns);
+        if (op.first == opType::INSERT) insertNs.push_back(ns);
+        else if (op.first == opType::REMOVE) removeNs.push_back(ns);
+        else containNs.push_back(ns);
+    }
+    result.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - runBegin).count() / 1e9;
+    result.opsPerSec = result.seconds > 0 ? work.operations / result.seconds : 0;
+    result.insertNs = pStats::of(std::move(insertNs));
+    result.containNs = pStats::of(std::move(containNs));
+    result.removeNs = pStats::of(std::move(removeNs));
+    result.allNs = pStats::of(std::move(allNs));
+    if (work.counters){
+        pCounters pc;
+        if (!pc.available())
+            cerr << "Warning: hardware counters are unavailable, only time is measured." << endl;
+        treeTemplate<int> replay;
+        for (auto key : preload)
+            replay.insert(key);
+        unsigned found = 0;
+        pc.start();
+        for (auto &op : ops){
+            if (op.first == opType::INSERT) replay.insert(op.second);
+            else if (op.first == opType::REMOVE) replay.remove(op.second);
+            else found += replay.contain(op.second);
+        }
+        pc.stop();
+        result.counters = pc.values();
+        if (found != result.found)
+            cerr << "Error: replayed workload found " << found << " keys instead of " << result.found << "." << endl;
+    }
+    // For node based trees without size() every live block is an element.
+    if constexpr (hasAllocStats<treeTemplate<int>>::value){
+        result.alloc = tree.allocStats();
+        size_t elements = result.alloc.liveBlocks();
+        if constexpr (hasSize<treeTemplate<int>>::value)
+            elements = tree.size();
+        result.bytesPerElement = result.alloc.bytesPerElement(elements);
+    }
+    return result;
+}
+
+// Print myTreeBenchmark results, mode = "Table", "CSV" or "JSON"
+void treeBenchReport(const vector<treeBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        os << std::left << std::setw(14) << "tree" << std::setw(15) << "distribution" << std::right
+           << std::setw(14) << "ops/sec" << std::setw(10) << "median" << std::setw(10) << "p95" << std::setw(10) << "p99"
+           << std::setw(12) << "contain p50" << std::setw(12) << "insert p50" << std::setw(12) << "remove p50"
+           << std::setw(14) << "peak bytes" << std::setw(10) << "B/elem" << std::setw(7) << "IPC"
+           << std::setw(10) << "L1d/op" << std::setw(10) << "LLC/op" << std::setw(10) << "br/op" << endl;
+        for (auto &r : results){
+            os << std::left << std::setw(14) << r.tree << std::setw(15) << r.distribution << std::right
+               << std::setw(14) << static_cast<uint64_t>(r.opsPerSec) << std::setw(10) << r.allNs.median
+               << std::setw(10) << r.allNs.p95 << std::setw(10) << r.allNs.p99 << std::setw(12) << r.containNs.median
+               << std::setw(12) << r.insertNs.median << std::setw(12) << r.removeNs.median
+               << std::setw(14) << r.alloc.peakBytes << std::setw(10) << r.bytesPerElement
+               << std::setw(7) << std::setprecision(2) << pCounters::ipc(r.counters) << std::setprecision(6);
+            for (auto e : {pCounters::L1D_MISSES, pCounters::LLC_MISSES, pCounters::BRANCH_MISSES})
+                os << std::setw(10) << (r.counters[e] < 0 ? -1.0 : r.counters[e] * 1.0 / std::max(r.operations, 1u));
+            os << endl;
+        }
+    } else if (mode == "CSV"){
+        os << "tree,distribution,operations,seconds,ops_per_sec,median_ns,p95_ns,p99_ns,contain_median_ns,insert_median_ns,remove_median_ns,"
+           << "allocations,frees,live_bytes,peak_bytes,bytes_per_element,ipc";
+        for (int e = 0; e < pCounters::EVENT_NUM; ++e)
+            os << "," << pCounters::name(static_cast<pCounters::event>(e));
+        os << endl;
+        for (auto &r : results){
+            os << r.tree << "," << r.distribution << "," << r.operations << "," << r.seconds << "," << r.opsPerSec
+               << "," << r.allNs.median << "," << r.allNs.p95 << "," << r.allNs.p99 << "," << r.containNs.median
+               << "," << r.insertNs.median << "," << r.removeNs.median << "," << r.alloc.allocations << "," << r.alloc.frees
+               << "," << r.alloc.liveBytes << "," << r.alloc.peakBytes << "," << r.bytesPerElement << "," << pCounters::ipc(r.counters);
+            for (auto c : r.counters)
+                os << "," << c;
+            os << endl;
+        }
+    } else if (mode == "JSON"){
+        auto latency = [&os](const char *key, const pStats &st){
+            os << ", \"" << key << "\": {\"count\": " << st.count << ", \"median\": " << st.median << ", \"p95\": " << st.p95
+               << ", \"p99\": " << st.p99 << ", \"max\": " << st.max << "}";
+        };
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"tree\": \"" << r.tree << "\", \"distribution\": \"" << r.distribution
+               << "\", \"operations\": " << r.operations << ", \"seconds\": " << r.seconds << ", \"ops_per_sec\": " << r.opsPerSec;
+            latency("all_ns", r.allNs);
+            latency("contain_ns", r.containNs);
+            latency("insert_ns", r.insertNs);
+            latency("remove_ns", r.removeNs);
+            os << ", \"alloc\": {\"allocations\": " << r.alloc.allocations << ", \"frees\": " << r.alloc.frees
+               << ", \"live_bytes\": " << r.alloc.liveBytes << ", \"peak_bytes\": " << r.alloc.peakBytes
+               << ", \"bytes_per_element\": " << r.bytesPerElement << "}, \"ipc\": " << pCounters::ipc(r.counters)
+               << ", \"counters\": {";
+            for (int e = 0; e < pCounters::EVENT_NUM; ++e)
+                os << (e == 0 ? "" : ", ") << "\"" << pCounters::name(static_cast<pCounters::event>(e)) << "\": " << r.counters[e];
+            os << "}}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
+}
+
+//
+//  Multi-threaded mode of myTreeBenchmark:
+//   1. readers threads only call contain(), writers threads insert and remove in the ratio insertRatio : removeRatio.
+//   2. work.operations are split evenly over the threads. Every thread draws its keys from work.distribution
+//      with its own generator (seed + thread index) before the start, so only the tree operations are timed.
+//   3. All threads start together, the time is taken until the last one finishes.
+//   4. The tree must be thread-safe, e.g. myConcurrentSkipList or myLockedTree.
+//   5. myTreeScaling() runs read-only, write-only and mixed configurations for every thread count.
+//
+
+// Result of myTreeBenchmarkConcurrent
+struct concurrentTreeBenchResult {
+    string tree;
+    string distribution;
+    unsigned readers = 0;
+    unsigned writers = 0;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t found = 0;         // successful contain, keeps the lookups from being optimized away
+    double seconds = 0;
+    double opsPerSec = 0;
+    double readsPerSec = 0;
+    double writesPerSec = 0;
+};
+
+template <template<typename U> typename treeTemplate>
+concurrentTreeBenchResult myTreeBenchmarkConcurrent(const treeWorkload &work, unsigned readers, unsigned writers, string name = "tree") {
+    concurrentTreeBenchResult result;
+    result.tree = name;
+    result.distribution = work.distribution;
+    result.readers = readers;
+    result.writers = writers;
+    unsigned threads = readers + writers;
+    if (threads == 0){
+        cerr << "Error: concurrent tree benchmark needs at least one thread." << endl;
+        return result;
+    }
+    treeTemplate<int> tree;
+    {
+        treeKeyGenerator keys(work);
+        for (unsigned i = 0; i < work.preload; ++i)
+            tree.insert(keys.nextUniform());
+    }
+    // Operations of every thread, true for insert
+    unsigned perThread = work.operations / threads;
+    double writeRatio = work.insertRatio + work.removeRatio;
+    double insertShare = writeRatio > 0 ? work.insertRatio / writeRatio : 0.5;
+    vector<vector<std::pair<bool, int>>> ops(threads);
+    for (unsigned t = 0; t < threads; ++t){
+        treeWorkload local = work;
+        local.seed = work.seed + 1 + t;
+        local.operations = perThread;
+        treeKeyGenerator keys(local);
+        ops[t].resize(perThread);
+        for (unsigned i = 0; i < perThread; ++i)
+            ops[t][i] = {keys.nextReal() < insertShare, keys.next(i)};
+    }
+    vector<uint64_t> found(threads, 0);
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t){
+        workers.emplace_back([&, t](){
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            uint64_t hits = 0;
+            if (t < readers){
+                for (auto &op : ops[t])
+                    hits += tree.contain(op.second);
+            } else {
+                for (auto &op : ops[t]){
+                    if (op.first) tree.insert(op.second);
+                    else tree.remove(op.second);
+                }
+            }
+            found[t] = hits;
+        });
+    }
+    while (ready.load() < threads)
+        std::this_thread::yield();
+    auto begin = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &w : workers)
+        w.join();
+    result.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count() / 1e9;
+    result.reads = static_cast<uint64_t>(readers) * perThread;
+    result.writes = static_cast<uint64_t>(writers) * perThread;
+    for (auto f : found)
+        result.found += f;
+    if (result.seconds > 0){
+        result.opsPerSec = (result.reads + result.writes) / result.seconds;
+        result.readsPerSec = result.reads / result.seconds;
+        result.writesPerSec = result.writes / result.seconds;
+    }
+    return result;
+}
+
+template <template<typename U> typename treeTemplate>
+vector<concurrentTreeBenchResult> myTreeScaling(const treeWorkload &work = treeWorkload(), string name = "tree",
+                                                const vector<unsigned> &threadCounts = {1, 2, 4, 8}) {
+    vector<concurrentTreeBenchResult> results;
+    for (unsigned t : threadCounts){
+        results.push_back(myTreeBenchmarkConcurrent<treeTemplate>(work, t, 0, name));
+        results.push_back(myTreeBenchmarkConcurrent<treeTemplate>(work, 0, t, name));
+        results.push_back(myTreeBenchmarkConcurrent<treeTemplate>(work, t, t, name));
+    }
+    return results;
+}
+
+// Print myTreeBenchmarkConcurrent results, mode = "Table", "CSV" or "JSON"
+void concurrentTreeBenchReport(const vector<concurrentTreeBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        auto flags = os.flags();
+        auto precision = os.precision();
+        os << std::left << std::setw(14) << "tree" << std::setw(15) << "distribution" << std::right
+           << std::setw(9) << "readers" << std::setw(9) << "writers" << std::setw(12) << "seconds"
+           << std::setw(14) << "ops/sec" << std::setw(14) << "reads/sec" << std::setw(14) << "writes/sec" << endl;
+        for (auto &r : results){
+            os << std::left << std::setw(14) << r.tree << std::setw(15) << r.distribution << std::right
+               << std::setw(9) << r.readers << std::setw(9) << r.writers << std::fixed << std::setprecision(6)
+               << std::setw(12) << r.seconds << std::defaultfloat
+               << std::setw(14) << static_cast<uint64_t>(r.opsPerSec) << std::setw(14) << static_cast<uint64_t>(r.readsPerSec)
+               << std::setw(14) << static_cast<uint64_t>(r.writesPerSec) << endl;
+        }
+        os.flags(flags);
+        os.precision(precision);
+    } else if (mode == "CSV"){
+        os << "tree,distribution,readers,writers,reads,writes,found,seconds,ops_per_sec,reads_per_sec,writes_per_sec" << endl;
+        for (auto &r : results){
+            os << r.tree << "," << r.distribution << "," << r.readers << "," << r.writers << "," << r.reads << "," << r.writes
+               << "," << r.found << "," << r.seconds << "," << r.opsPerSec << "," << r.readsPerSec << "," << r.writesPerSec << endl;
+        }
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"tree\": \"" << r.tree << "\", \"distribution\": \"" << r.distribution
+               << "\", \"readers\": " << r.readers << ", \"writers\": " << r.writers << ", \"reads\": " << r.reads
+               << ", \"writes\": " << r.writes << ", \"found\": " << r.found << ", \"seconds\": " << r.seconds
+               << ", \"ops_per_sec\": " << r.opsPerSec << ", \"reads_per_sec\": " << r.readsPerSec
+               << ", \"writes_per_sec\": " << r.writesPerSec << "}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
 }
 
 
+
 //
 // -------------------- Hash Table --------------------
 //
@@ -1395,7 +7162,22 @@ template <typename T>
 class mySCHashTable {
 public:
     explicit mySCHashTable(size_t initSize = 101){
-        theLists = vector<std::list<T>>(initSize);
+        theLists = newLists(initSize);
+    }
+    // The chain allocators point at the stats of their own table, so a copy or a move rebuilds
+    // the buckets of this table and copies or moves the elements into them.
+    mySCHashTable(const mySCHashTable &rhs): theLists(newLists(rhs.theLists.size())), num(rhs.num) {
+        for (size_t i = 0; i < rhs.theLists.size(); ++i)
+            theLists[i].assign(rhs.theLists[i].begin(), rhs.theLists[i].end());
+    }
+    mySCHashTable(mySCHashTable &&rhs): theLists(newLists(rhs.theLists.size())), num(rhs.num) {
+        moveBuckets(rhs);
+    }
+    mySCHashTable &operator=(mySCHashTable rhs) {
+        theLists = newLists(rhs.theLists.size());
+        num = rhs.num;
+        moveBuckets(rhs);
+        return *this;
     }
     ~mySCHashTable(){
         clear();
@@ -1414,10 +7196,14 @@ public:
         return num == 0;
     }
     void clear() {
-        for (auto l : theLists)
+        for (auto &l : theLists)
             l.clear();
         num = 0;
     }
+    // Allocation statistics, including the bucket array and chain nodes.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
     bool contain(T val) const {
         auto index = hash(val);
         return std::find(theLists[index].begin(), theLists[index].end(), val) != theLists[index].end();
@@ -1452,15 +7238,29 @@ public:
 
 private:
     // use std::vector to contain chains
-    vector<std::list<T>> theLists;
+    // chains and the bucket array report to stats through myCountingAllocator.
+    using chain = std::list<T, myCountingAllocator<T>>;
+    using bucketArray = vector<chain, myCountingAllocator<chain>>;
+    myAllocStats stats;
+    bucketArray theLists;
+    bucketArray newLists(size_t size) {
+        return bucketArray(size, chain(myCountingAllocator<T>(&stats)), myCountingAllocator<chain>(&stats));
+    }
     // number of element.
     unsigned num = 0;
+    // Move the elements of rhs into the same buckets of theLists, rhs becomes empty
+    void moveBuckets(mySCHashTable &rhs) {
+        for (size_t i = 0; i < rhs.theLists.size(); ++i)
+            theLists[i].assign(std::make_move_iterator(rhs.theLists[i].begin()), std::make_move_iterator(rhs.theLists[i].end()));
+        rhs.clear();
+    }
     // rehash routine: if no new size pass in, double the size.
     void rehash(int newSize = 0) {
         if (newSize == 0) newSize = 2*theLists.size() + 1;
-        auto oldLists = theLists;
-        clear();
-        theLists = vector<std::list<T>>(newSize);
+        // Move the old chains out instead of copying every element.
+        auto oldLists = std::move(theLists);
+        num = 0;
+        theLists = newLists(newSize);
         for (auto &l : oldLists){
             for (auto &val : l)
                 insert(std::move(val));
@@ -1806,6 +7606,10 @@ public:
     bool empty() const {
         return root == nullptr;
     }
+    // Allocation statistics, one live block per element.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
 
     const T &findMin() {
         return root->value;
@@ -1820,19 +7624,19 @@ public:
 
     // Insertion can be regarded as merge this with a single node heap.
     void insert(const T &val) {
-        node *newNode = new node{val, 0, nullptr, nullptr};
-        merge(root, newNode);
+        node *ptr = newNode(val, 0, nullptr, nullptr);
+        merge(root, ptr);
     }
     void insert(T &&val) {
-        node *newNode = new node{std::move(val), 0, nullptr, nullptr};
-        merge(root, newNode);
+        node *ptr = newNode(std::move(val), 0, nullptr, nullptr);
+        merge(root, ptr);
     }
 
     // Delete min operation can be implemented by deleting root and merging two children of it.
     void deleteMin() {
         merge(root->left, root->right);
         node *newRoot = root->left;
-        delete root;
+        deleteNode(root);
         root = newRoot;
     }
 
@@ -1858,14 +7662,25 @@ private:
 
     node *clone(node *ptr) {
         if (ptr == nullptr) return nullptr;
-        return new node {ptr->value, clone(ptr->left), clone(ptr->right)};
+        return newNode(ptr->value, ptr->npl, clone(ptr->left), clone(ptr->right));
+    }
+
+    // All nodes are created and destroyed here, so they can be counted.
+    template <typename... Args>
+    node *newNode(Args &&...args) {
+        stats.onAlloc(sizeof(node));
+        return new node{std::forward<Args>(args)...};
+    }
+    void deleteNode(node *ptr) {
+        stats.onFree(sizeof(node));
+        delete ptr;
     }
 
     void clear(node *&ptr) {
         if (ptr == nullptr) return;
         clear(ptr->left);
         clear(ptr->right);
-        delete ptr;
+        deleteNode(ptr);
         ptr = nullptr;
     }
 
@@ -1891,6 +7706,7 @@ private:
     }
 
     node *root = nullptr;
+    myAllocStats stats;
 };
 
 
@@ -2095,45 +7911,59 @@ void myMergeSort(vector<T> &v){
 //  3. Details can impact quick sort performance greatly!
 //  4. For small vector (size <= cutoff), using insertion sort.
 //
+template<typename T>
+int quickPartition(vector<T> &v, int start, int end);
+
 template<typename T>
 void myQuickSort(vector<T> &v, int start, int end, unsigned cutoff = 0){
     // Base case
     if (end - start < 1) return;
 
     if (end - start >= cutoff){
-        // Median-of-Three Partitioning:
-        //  Sorting start, center and end elements, set median of them as the pivot.
-        int center = (start+end)/2;
-        if (v[start] > v[center])
-            std::swap(v[start], v[center]);
-        if (v[center] > v[end])
-            std::swap(v[center], v[end]);
-        if (v[start] > v[center])
-            std::swap(v[start], v[center]);
-        
-        // Move pivot to the second last position.
-        auto pivot = v[center];
-        std::swap(v[center], v[end-1]);
-        // Set i, j indexes
-        int i = start, j = end-1;
-        while (true){
-            while (v[i] < pivot) ++i;
-            while (v[j] > pivot) --j;
-            // When i and j meet, break.
-            if (i >= j) break;
-            // Swap i and j elements.
-            // Here the '++' and '--' is very important.
-            // Consider the case when :
-            //  v[i] = v[j] = pivot, i < j.
-            std::swap(v[i++], v[j--]);
-        }
-        // Move pivot to the middle.
-        std::swap(v[i], v[end-1]);
+        int i = quickPartition(v, start, end);
+        if (i < 0) return;
         // Iteration.
-        myQuickSort(v, start, i-1);
-        myQuickSort(v, i+1, end);
+        myQuickSort(v, start, i-1, cutoff);
+        myQuickSort(v, i+1, end, cutoff);
     } else myInsertionSort(v, start, end);
 }
+// Partition routine of quick sort, v[start..end] has at least two elements.
+// Return the final position of the pivot, or -1 if three or less elements are sorted already.
+template<typename T>
+int quickPartition(vector<T> &v, int start, int end){
+    // Median-of-Three Partitioning:
+    //  Sorting start, center and end elements, set median of them as the pivot.
+    int center = (start+end)/2;
+    if (v[start] > v[center])
+        std::swap(v[start], v[center]);
+    if (v[center] > v[end])
+        std::swap(v[center], v[end]);
+    if (v[start] > v[center])
+        std::swap(v[start], v[center]);
+
+    // Three or less elements are already sorted by median-of-three.
+    if (end - start < 3) return -1;
+    // Move pivot to the second last position.
+    auto pivot = v[center];
+    std::swap(v[center], v[end-1]);
+    // Set i, j indexes
+    // v[start] <= pivot and v[end-1] == pivot work as sentinels of the two scans.
+    int i = start, j = end-1;
+    while (true){
+        // Here the pre-increment is very important.
+        // Consider the case when :
+        //  v[i] = v[j] = pivot, i < j.
+        while (v[++i] < pivot) {}
+        while (pivot < v[--j]) {}
+        // When i and j meet, break.
+        if (i >= j) break;
+        // Swap i and j elements.
+        std::swap(v[i], v[j]);
+    }
+    // Move pivot to the middle.
+    std::swap(v[i], v[end-1]);
+    return i;
+}
 // Quick sort activation routine.
 template <typename T>
 void myQuickSort(vector<T> &v, unsigned cutoff = 0){
@@ -2141,34 +7971,256 @@ void myQuickSort(vector<T> &v, unsigned cutoff = 0){
 }
 
 
+//
+// Parallel merge sort:
+//  1. The two halves are sorted as a fork / join pair on myThreadPool, then merged by the caller.
+//  2. Ranges of at most grain elements use the serial mergeSort.
+//
+template <typename T>
+void parallelMergeSort(vector<T> &v, vector<T> &tmp, int start, int end, int grain, myThreadPool &pool) {
+    if (end - start < grain){
+        mergeSort(v, tmp, start, end);
+        return;
+    }
+    int center = (start+end)/2;
+    myTaskGroup group(pool);
+    group.fork([&]{ parallelMergeSort(v, tmp, start, center, grain, pool); });
+    parallelMergeSort(v, tmp, center+1, end, grain, pool);
+    group.join();
+    merge(v, tmp, start, center+1, end);
+}
+template <typename T>
+void myParallelMergeSort(vector<T> &v, int grain = 4096, myThreadPool &pool = myThreadPool::instance()){
+    vector<T> tmp(v.size());
+    parallelMergeSort(v, tmp, 0, static_cast<int>(v.size()) - 1, std::max(grain, 2), pool);
+}
+
+//
+// Parallel quick sort:
+//  1. After partition the left part is forked, the right part is continued by the caller.
+//  2. Ranges of at most grain elements use the serial myQuickSort with cutoff.
+//
+template <typename T>
+void parallelQuickSort(vector<T> &v, int start, int end, int grain, unsigned cutoff, myTaskGroup &group) {
+    while (end - start >= grain){
+        int i = quickPartition(v, start, end);
+        if (i < 0) return;
+        group.fork([&v, start, i, grain, cutoff, &group]{ parallelQuickSort(v, start, i-1, grain, cutoff, group); });
+        start = i + 1;
+    }
+    myQuickSort(v, start, end, cutoff);
+}
+template <typename T>
+void myParallelQuickSort(vector<T> &v, int grain = 4096, unsigned cutoff = 10, myThreadPool &pool = myThreadPool::instance()){
+    myTaskGroup group(pool);
+    parallelQuickSort(v, 0, static_cast<int>(v.size()) - 1, std::max(grain, 2), cutoff, group);
+    group.join();
+}
+
+
+
+//
+// Sort Benchmark:
+//  1. Input shapes: "Random", "Sorted", "Reversed", "FewUnique", "OrganPipe", "NearlySorted".
+//     Inputs are generated once per (shape, size) from a seeded std::mt19937, not from std::random_device.
+//  2. Every sort runs some warmup rounds, then repeats until at least minReps runs are done and
+//     either the relative standard error of the mean drops under targetError, minTimeMs is spent or maxReps is reached.
+//  3. Only the sort call is timed. Input copy and validation are done outside the timed region.
+//  4. Every output is compared with std::sort, a sort producing a wrong result is marked as incorrect.
+//  5. Results are in nanoseconds per element and can be printed as "Table", "CSV" or "JSON".
+//
+
+// Generate an int input of given shape and size.
+vector<int> sortInput(const string &shape, unsigned n, unsigned seed = 2021) {
+    std::mt19937 gen(seed);
+    vector<int> v(n);
+    if (shape == "Random"){
+        for (auto &x : v) x = static_cast<int>(gen());
+    } else if (shape == "Sorted"){
+        for (unsigned i = 0; i < n; ++i) v[i] = i;
+    } else if (shape == "Reversed"){
+        for (unsigned i = 0; i < n; ++i) v[i] = n - i;
+    } else if (shape == "FewUnique"){
+        for (auto &x : v) x = gen() % 16;
+    } else if (shape == "OrganPipe"){
+        // Ascending to the middle, then descending.
+        for (unsigned i = 0; i < n; ++i) v[i] = i < n/2 ? i : n - i;
+    } else if (shape == "NearlySorted"){
+        // Sorted with 1% of elements swapped at random.
+        for (unsigned i = 0; i < n; ++i) v[i] = i;
+        for (unsigned i = 0; i < n / 100 + 1 && n > 1; ++i)
+            std::swap(v[gen() % n], v[gen() % n]);
+    } else {
+        cerr << "Error: unknown input shape " << shape << "." << endl;
+    }
+    return v;
+}
+
+// Configuration of sortBenchmark
+struct sortBenchConfig {
+    vector<unsigned> sizes{1000, 10000, 100000};
+    vector<string> shapes{"Random", "Sorted", "Reversed", "FewUnique", "OrganPipe", "NearlySorted"};
+    unsigned warmup = 2;
+    unsigned minReps = 5;
+    unsigned maxReps = 200;
+    double minTimeMs = 200;
+    double targetError = 0.01;
+    unsigned seed = 2021;
+    // Measure pCounters in an extra untimed run of every sort
+    bool counters = false;
+};
+
+// One line of sortBenchmark result
+struct sortBenchResult {
+    string sort;
+    string shape;
+    unsigned n = 0;
+    unsigned reps = 0;
+    bool correct = true;
+    pStats nsPerElement;
+    // pCounters values of one run, -1 if not measured
+    pCounters::sample counters = pCounters::sample{{-1, -1, -1, -1, -1, -1}};
+};
+
+// Run every sort on every (shape, size) of config.
+vector<sortBenchResult> sortBenchmark(const vector<std::pair<string, std::function<void(vector<int> &)>>> &sorts,
+                                      const sortBenchConfig &config = sortBenchConfig()) {
+    vector<sortBenchResult> results;
+    pCounters pc;
+    if (config.counters && !pc.available())
+        cerr << "Warning: hardware counters are unavailable, only time is measured." << endl;
+    for (auto &shape : config.shapes){
+        for (auto n : config.sizes){
+            const vector<int> input = sortInput(shape, n, config.seed);
+            vector<int> expected = input;
+            std::sort(expected.begin(), expected.end());
+            for (auto &item : sorts){
+                sortBenchResult result;
+                result.sort = item.first;
+                result.shape = shape;
+                result.n = n;
+                vector<int> v;
+                for (unsigned i = 0; i < config.warmup; ++i){
+                    v = input;
+                    item.second(v);
+                    result.correct = result.correct && v == expected;
+                }
+                vector<double> samples;
+                double totalNs = 0, sum = 0, sq = 0;
+                while (samples.size() < config.maxReps){
+                    v = input;
+                    auto begin = std::chrono::steady_clock::now();
+                    item.second(v);
+                    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+                    result.correct = result.correct && v == expected;
+                    double x = ns * 1.0 / std::max(n, 1u);
+                    samples.push_back(x);
+                    totalNs += ns;
+                    sum += x;
+                    sq += x * x;
+                    if (samples.size() < config.minReps) continue;
+                    // Relative standard error of the mean
+                    double k = samples.size(), mean = sum / k;
+                    double var = std::max(0.0, (sq - k * mean * mean) / (k - 1));
+                    if (mean > 0 && std::sqrt(var / k) / mean < config.targetError) break;
+                    if (totalNs / 1e6 >= config.minTimeMs) break;
+                }
+                result.reps = samples.size();
+                result.nsPerElement = pStats::of(samples);
+                // Counters are read in their own run, so the ioctl calls do not disturb the timing.
+                if (config.counters && pc.available()){
+                    v = input;
+                    pc.start();
+                    item.second(v);
+                    pc.stop();
+                    result.counters = pc.values();
+                }
+                if (!result.correct)
+                    cerr << "Error: " << item.first << " gives a wrong result on " << shape << " input of size " << n << "." << endl;
+                results.push_back(result);
+            }
+        }
+    }
+    return results;
+}
 
+// Print sortBenchmark results, mode = "Table", "CSV" or "JSON"
+void sortBenchReport(const vector<sortBenchResult> &results, std::ostream &os = std::cout, string mode = "Table") {
+    if (mode == "Table"){
+        auto flags = os.flags();
+        auto precision = os.precision();
+        os << std::left << std::setw(16) << "sort" << std::setw(14) << "shape" << std::right
+           << std::setw(10) << "n" << std::setw(7) << "reps" << std::setw(12) << "median" << std::setw(12) << "p95"
+           << std::setw(12) << "p99" << std::setw(12) << "stddev" << std::setw(7) << "IPC"
+           << std::setw(10) << "L1d/n" << std::setw(10) << "LLC/n" << std::setw(10) << "br/n" << "   (ns/element)" << endl;
+        for (auto &r : results){
+            os << std::left << std::setw(16) << r.sort << std::setw(14) << r.shape << std::right
+               << std::setw(10) << r.n << std::setw(7) << r.reps << std::fixed << std::setprecision(3)
+               << std::setw(12) << r.nsPerElement.median << std::setw(12) << r.nsPerElement.p95
+               << std::setw(12) << r.nsPerElement.p99 << std::setw(12) << r.nsPerElement.stddev
+               << std::setw(7) << std::setprecision(2) << pCounters::ipc(r.counters);
+            for (auto e : {pCounters::L1D_MISSES, pCounters::LLC_MISSES, pCounters::BRANCH_MISSES})
+                os << std::setw(10) << (r.counters[e] < 0 ? -1.0 : r.counters[e] * 1.0 / std::max(r.n, 1u));
+            os << (r.correct ? "" : "   WRONG") << endl;
+        }
+        os.flags(flags);
+        os.precision(precision);
+    } else if (mode == "CSV"){
+        os << "sort,shape,n,reps,correct,min,median,mean,p95,p99,max,stddev,ipc";
+        for (int e = 0; e < pCounters::EVENT_NUM; ++e)
+            os << "," << pCounters::name(static_cast<pCounters::event>(e));
+        os << endl;
+        for (auto &r : results){
+            os << r.sort << "," << r.shape << "," << r.n << "," << r.reps << "," << (r.correct ? "true" : "false")
+               << "," << r.nsPerElement.min << "," << r.nsPerElement.median << "," << r.nsPerElement.mean
+               << "," << r.nsPerElement.p95 << "," << r.nsPerElement.p99 << "," << r.nsPerElement.max
+               << "," << r.nsPerElement.stddev << "," << pCounters::ipc(r.counters);
+            for (auto c : r.counters)
+                os << "," << c;
+            os << endl;
+        }
+    } else if (mode == "JSON"){
+        os << "[";
+        for (size_t i = 0; i < results.size(); ++i){
+            auto &r = results[i];
+            os << (i == 0 ? "" : ", ") << "{\"sort\": \"" << r.sort << "\", \"shape\": \"" << r.shape
+               << "\", \"n\": " << r.n << ", \"reps\": " << r.reps << ", \"correct\": " << (r.correct ? "true" : "false")
+               << ", \"ns_per_element\": {\"min\": " << r.nsPerElement.min << ", \"median\": " << r.nsPerElement.median
+               << ", \"mean\": " << r.nsPerElement.mean << ", \"p95\": " << r.nsPerElement.p95
+               << ", \"p99\": " << r.nsPerElement.p99 << ", \"max\": " << r.nsPerElement.max
+               << ", \"stddev\": " << r.nsPerElement.stddev << "}, \"ipc\": " << pCounters::ipc(r.counters)
+               << ", \"counters\": {";
+            for (int e = 0; e < pCounters::EVENT_NUM; ++e)
+                os << (e == 0 ? "" : ", ") << "\"" << pCounters::name(static_cast<pCounters::event>(e)) << "\": " << r.counters[e];
+            os << "}}";
+        }
+        os << "]" << endl;
+    } else {
+        cerr << "Error: unknown report mode " << mode << "." << endl;
+    }
+}
 
 //
 // Sort Routine Evaluator:
 //  1. A routine to evaluate the performance of a sort function.
 //  2. Using int type.
 //  3. sort function should be passed in through function object.
+//  4. Built on sortBenchmark, the histogram shows median running time in microseconds of random input.
 //
 template <typename sortClass>
 void sortEval(sortClass sort, unsigned inputNumLimit = 20000) {
-    vector<int> x;
-    vector<unsigned> y;
-    std::random_device rd;
-    pTime pt;
-
-    // start input num
-    int inputNum = 1000;
-    while (inputNum <= inputNumLimit){
-        vector<int> input;
-        for (auto i = 0; i < inputNum; ++i)
-            input.push_back(rd());
-        pt.start();
-        sort(input);
-        pt.end();
-        x.push_back(inputNum);
-        y.push_back(pt.duration());
-        // double input
-        inputNum *= 2;
+    sortBenchConfig config;
+    config.shapes = {"Random"};
+    config.sizes.clear();
+    // start input num, double each time
+    for (unsigned inputNum = 1000; inputNum <= inputNumLimit; inputNum *= 2)
+        config.sizes.push_back(inputNum);
+    auto results = sortBenchmark({{"sort", [&sort](vector<int> &v){ sort(v); }}}, config);
+    vector<unsigned> x;
+    vector<double> y;
+    for (auto &r : results){
+        x.push_back(r.n);
+        y.push_back(r.nsPerElement.median * r.n / 1000);
     }
     // show in histogram
     myHist(x, y, 50);
@@ -2256,11 +8308,17 @@ public:
     }
     void clear() {
         if (empty()) return;
-        for (auto name : vertices)
+        for (auto name : vertices){
+            stats.onFree(sizeof(vertex));
             delete vMap[name];
+        }
         vMap.clear();
         vertices.clear();
     }
+    // Allocation statistics of vertices and adjacent lists.
+    const myAllocStats &allocStats() const {
+        return stats;
+    }
     // Using std::find
     bool contain(std::string vName) const {
         return std::find(vertices.begin(), vertices.end(), vName) != vertices.end();
@@ -2291,7 +8349,8 @@ public:
             cerr << "Name of new vertex already exists." << endl;
             return;
         }
-        vertex *newVertex = new vertex(vName);
+        vertex *newVertex = new vertex(vName, &stats);
+        stats.onAlloc(sizeof(vertex));
         vertices.push_back(vName);
         newVertex->index = vertices.size()-1;
         vMap[vName] = newVertex;
@@ -2423,6 +8482,7 @@ public:
     // Top Sort:
     // 1. Using std::queue to get vertex with zero indegree.
     void topSort() {
+        PTIME_SCOPE("myGraph::topSort");
         if (empty()) return;
         std::queue<vertex*> zeroIndegree;
         // First scan through all vertices, find all vertices with zero indegree.
@@ -2456,6 +8516,7 @@ public:
     // Find the minimum unweighted distance from start vertex to each vertices 
     // 1. using a queue to process, so known data field is not needed.
     void minPathUnweighted(std::string start){
+        PTIME_SCOPE("myGraph::minPathUnweighted");
         // Initialize distances
         for (auto name : vertices)
             vMap[name]->distance = INFINITE;
@@ -2481,10 +8542,52 @@ public:
         }
     }
 
+    // Parallel version of minPathUnweighted on myThreadPool
+    // 1. Level synchronous: all vertices of the frontier are expanded by myParallelFor.
+    // 2. A vertex is claimed by an atomic flag, so it gets exactly one last vertex.
+    // 3. Distances are the same as minPathUnweighted, last may be another vertex of the previous level.
+    void minPathUnweightedParallel(std::string start, myThreadPool &pool = myThreadPool::instance()){
+        PTIME_SCOPE("myGraph::minPathUnweightedParallel");
+        std::vector<std::atomic<bool>> visited(getSize());
+        for (auto name : vertices){
+            vMap[name]->distance = INFINITE;
+            visited[vMap[name]->index].store(false, std::memory_order_relaxed);
+        }
+        vertex *ptr = vMap[start];
+        ptr->distance = 0;
+        ptr->last = nullptr;
+        visited[ptr->index].store(true, std::memory_order_relaxed);
+        std::vector<vertex *> frontier{ptr};
+        T level = 0;
+        while (!frontier.empty()){
+            // Every chunk of the frontier collects its own part of the next frontier
+            size_t chunk = 64, chunks = (frontier.size() + chunk - 1) / chunk;
+            std::vector<std::vector<vertex *>> next(chunks);
+            myParallelFor(0, chunks, [&](size_t c){
+                for (size_t k = c * chunk; k < std::min(frontier.size(), (c + 1) * chunk); ++k){
+                    for (auto item : frontier[k]->adjList){
+                        vertex *adj = item.first;
+                        if (!visited[adj->index].load(std::memory_order_relaxed)
+                            && !visited[adj->index].exchange(true, std::memory_order_relaxed)){
+                            adj->distance = level + 1;
+                            adj->last = frontier[k];
+                            next[c].push_back(adj);
+                        }
+                    }
+                }
+            }, 1, pool);
+            frontier.clear();
+            for (auto &part : next)
+                frontier.insert(frontier.end(), part.begin(), part.end());
+            ++level;
+        }
+    }
+
     // Find the minimum weighted distance from start vertex to each vertices
     // 1. Weight can be negative, but cannot have negative-cost cycle
     // 2. known member indicate whether the vertex is in the queue
     void minPathWeightedNegative(std::string start){
+        PTIME_SCOPE("myGraph::minPathWeightedNegative");
         std::queue<vertex *> q;
         // Initialize
         for (auto name : vertices){
@@ -2523,6 +8626,7 @@ public:
     // 2. Non-negative cost 
     // 3. mode = "min" or "max" determine to find the minimum distance of maximum distance.
     void Dijkstra(std::string start, std::string mode = "min") {
+        PTIME_SCOPE("myGraph::Dijkstra");
         // Initialize all vertices
         for (auto name : vertices){
             vertex *ptr = vMap[name];
@@ -2569,6 +8673,7 @@ public:
     // Dijkstra Algorithhm
     // 1. No cycle allowed
     void DijkstraNoCycle(std::string start, std::string mode = "min"){
+        PTIME_SCOPE("myGraph::DijkstraNoCycle");
         topSort();
         std::vector<vertex *> fetchList(getSize());
         // Initialize vertices
@@ -2610,6 +8715,7 @@ public:
     // 1. Using Dijkstra to find paths of residual graph.
     //
     T maxFlow(std::string start, std::string finish) const {
+        PTIME_SCOPE("myGraph::maxFlow");
         T maxFlow = 0;
         // Create residual graph
         myGraph res(*this);
@@ -2657,6 +8763,7 @@ public:
     // 3. No Direction Graph
     //
     void Prim() {
+        PTIME_SCOPE("myGraph::Prim");
         std::vector<edge> edges = myPrim();
         printConnect(edges);
     }
@@ -2667,6 +8774,7 @@ public:
     //  2. No Direction Graph
     //
     void Kruskal() const {
+        PTIME_SCOPE("myGraph::Kruskal");
         std::vector<edge> edges = myKruskal();
         printConnect(edges);
     }
@@ -2686,8 +8794,9 @@ private:
         // record the last vertex to it. to retrace the path.
         vertex* last= nullptr;
         // adjList contains the vertices linked and weights of the edges as pairs.
-        std::list<std::pair<vertex*, T>> adjList;
-        vertex(std::string vName): name(vName) {}
+        std::list<std::pair<vertex*, T>, myCountingAllocator<std::pair<vertex*, T>>> adjList;
+        vertex(std::string vName, myAllocStats *stats):
+            name(vName), adjList(myCountingAllocator<std::pair<vertex*, T>>(stats)) {}
     };
 
     struct edge {
@@ -2803,6 +8912,7 @@ private:
     std::vector<std::string> vertices;
     // map to find the pointer to the vertex structure
     std::unordered_map<std::string, vertex*> vMap;
+    myAllocStats stats;
 };
 
 //
@@ -2823,106 +8933,400 @@ T mySelectionProblem1(const vector<T> &array, int k){
     return pq.top();
 }
 
+//
+//  Selection Problem solution 2:
+//  The k-th largest distinct value of a myAVLTree in O(log n) with select(), the tree may keep changing between queries.
+//
+template <typename T>
+T mySelectionProblem2(const myAVLTree<T> &tree, int k){
+    if (k < 1 || static_cast<size_t>(k) > tree.size()){
+        cerr << "Error: k should be in [1, " << tree.size() << "]." << endl;
+        return {};
+    }
+    return tree.select(tree.size() - k);
+}
+
 //
 //  Brace checker:
-//  1. Check a file string object (e.g. extracted from a file) whether the braces are balanced ("(", "[", "{"). 
-//  2. Using a std::stack data structure
-//
-void myBraceChecker(const string &fileName) {
-    std::ifstream input(fileName);
-    // To record current position
-    unsigned line = 1, column = 1;
-    // Indicate whether there is an brace error
-    bool error = false;
-    // Implement with std::stack data structure
-    std::stack<char> braceStack;
-    char c;
-    while (input.get(c)){
-        if ( c == ')' ){
-            if (braceStack.empty() || braceStack.top() != '('){
-                error = true;
-                break;
+//  1. Check a file whether the braces are balanced ("(", "[", "{").
+//  2. The first error is reported by its line and column (both 1-based, column counts bytes):
+//     a closing brace which does not match, or else the innermost opening brace left unclosed at the end.
+//  3. "Normal" mode reads the file char by char, using a myStack data structure with inline storage.
+//  4. "Parallel" mode mmaps the file and splits it into chunks checked on the thread pool, see braceCheckParallel().
+//
+struct braceCheckResult {
+    bool balanced = true;
+    bool unclosed = false;      // error is an opening brace never closed, otherwise a closing brace without match
+    size_t offset = 0;          // byte offset of the offending brace
+    size_t line = 0;
+    size_t column = 0;
+};
+
+bool braceMatch(char open, char close) {
+    return (open == '(' && close == ')') || (open == '[' && close == ']') || (open == '{' && close == '}');
+}
+
+//
+//  Call visit(p) for every brace byte in [begin, end) until it returns false, return the newlines in the scanned blocks.
+//  Blocks of 32 (AVX2) or 16 (SSE2) bytes are classified at once: brace bytes satisfy (c | 0x20) == '{' or '}'
+//  (which covers '[' and ']') or (c & 0xFE) == '(' (which covers ')'). Blocks without a brace cost a few instructions.
+//
+template <typename Visit>
+size_t braceScan(const char *begin, const char *end, const Visit &visit) {
+    size_t newlines = 0;
+    const char *p = begin;
+# if defined(__AVX2__)
+    const __m256i lower = _mm256_set1_epi8(0x20), round = _mm256_set1_epi8(static_cast<char>(0xFE));
+    const __m256i curlyOpen = _mm256_set1_epi8('{'), curlyClose = _mm256_set1_epi8('}');
+    const __m256i paren = _mm256_set1_epi8('('), newline = _mm256_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i folded = _mm256_or_si256(v, lower);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, curlyOpen), _mm256_cmpeq_epi8(folded, curlyClose)),
+                                      _mm256_cmpeq_epi8(_mm256_and_si256(v, round), paren));
+        uint32_t braces = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        newlines += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline))));
+        for (; braces != 0; braces &= braces - 1)
+            if (!visit(p + __builtin_ctz(braces))) return newlines;
+    }
+# elif defined(__SSE2__)
+    const __m128i lower = _mm_set1_epi8(0x20), round = _mm_set1_epi8(static_cast<char>(0xFE));
+    const __m128i curlyOpen = _mm_set1_epi8('{'), curlyClose = _mm_set1_epi8('}');
+    const __m128i paren = _mm_set1_epi8('('), newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i folded = _mm_or_si128(v, lower);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, curlyOpen), _mm_cmpeq_epi8(folded, curlyClose)),
+                                   _mm_cmpeq_epi8(_mm_and_si128(v, round), paren));
+        uint32_t braces = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+        newlines += __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))));
+        for (; braces != 0; braces &= braces - 1)
+            if (!visit(p + __builtin_ctz(braces))) return newlines;
+    }
+# endif
+    for (; p < end; ++p){
+        char c = *p;
+        if (c == '\n') ++newlines;
+        else if (((c | 0x20) == '{' || (c | 0x20) == '}' || (c & 0xFE) == '(') && !visit(p)) return newlines;
+    }
+    return newlines;
+}
+
+//
+//  Parallel brace check of data[0, size):
+//  1. Every chunk is matched locally. What is left is a summary: closing braces without opener in the chunk (prefix),
+//     opening braces not closed in the chunk (suffix) and the first closing brace meeting a wrong opener.
+//  2. Summaries are merged in order: prefix closers match the openers left by earlier chunks, then the suffix is pushed.
+//     This finds the same first error as a sequential scan.
+//  3. Line and column are computed only for the error, from newline counts of the chunks before it.
+//
+braceCheckResult braceCheckParallel(const char *data, size_t size, myThreadPool &pool = myThreadPool::instance()) {
+    const size_t CHUNK_BYTES = 1 << 20;
+    const size_t NONE = static_cast<size_t>(-1);
+    struct chunkSummary {
+        vector<size_t> closers;     // offsets of closing braces without opener in the chunk, in order
+        vector<size_t> openers;     // offsets of opening braces not closed in the chunk, bottom first
+        size_t mismatch = NONE;     // offset of the first closing brace meeting a wrong opener
+        size_t newlines = 0;
+    };
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(size / CHUNK_BYTES, (pool.size() + 1) * 4));
+    auto chunkBegin = [&](size_t i){ return size / chunks * i + std::min(i, size % chunks); };
+    vector<chunkSummary> summary(chunks);
+    myParallelFor(0, chunks, [&](size_t i){
+        chunkSummary &s = summary[i];
+        s.newlines = braceScan(data + chunkBegin(i), data + chunkBegin(i + 1), [&](const char *p){
+            size_t offset = p - data;
+            if (*p == '(' || *p == '[' || *p == '{'){
+                s.openers.push_back(offset);
+            } else if (s.openers.empty()){
+                s.closers.push_back(offset);
+            } else if (braceMatch(data[s.openers.back()], *p)){
+                s.openers.pop_back();
+            } else {
+                s.mismatch = offset;
+                return false;
             }
-            else braceStack.pop();
-        } else if ( c == ']' ){
-            if (braceStack.empty() || braceStack.top() != '['){
-                error = true;
+            return true;
+        });
+    }, 1, pool);
+
+    braceCheckResult result;
+    size_t errorChunk = 0;
+    vector<size_t> openers;
+    for (size_t i = 0; i < chunks && result.balanced; ++i){
+        for (size_t offset : summary[i].closers){
+            if (openers.empty() || !braceMatch(data[openers.back()], data[offset])){
+                result.balanced = false;
+                result.offset = offset;
                 break;
             }
-            else braceStack.pop();
-        } else if ( c == '}' ){
-            if (braceStack.empty() || braceStack.top() != '{'){
-                error = true;
-                break;
+            openers.pop_back();
+        }
+        if (result.balanced && summary[i].mismatch != NONE){
+            result.balanced = false;
+            result.offset = summary[i].mismatch;
+        }
+        if (!result.balanced){
+            errorChunk = i;
+            break;
+        }
+        openers.insert(openers.end(), summary[i].openers.begin(), summary[i].openers.end());
+    }
+    if (result.balanced && !openers.empty()){
+        result.balanced = false;
+        result.unclosed = true;
+        result.offset = openers.back();
+        while (chunkBegin(errorChunk + 1) <= result.offset) ++errorChunk;
+    }
+    if (result.balanced) return result;
+
+    result.line = 1;
+    for (size_t i = 0; i < errorChunk; ++i)
+        result.line += summary[i].newlines;
+    result.line += braceScan(data + chunkBegin(errorChunk), data + result.offset, [](const char *){ return true; });
+    size_t lineStart = result.offset;
+    while (lineStart > 0 && data[lineStart - 1] != '\n') --lineStart;
+    result.column = result.offset - lineStart + 1;
+    return result;
+}
+
+void myBraceChecker(const string &fileName, string mode = "Normal", myThreadPool &pool = myThreadPool::instance()) {
+    braceCheckResult result;
+    if (mode == "Normal"){
+        std::ifstream input(fileName);
+        if (!input){
+            cerr << "Error: cannot open " << fileName << "." << endl;
+            return;
+        }
+        // Opening braces are kept with their position, to report an unclosed one
+        struct brace {
+            char c;
+            size_t offset, line, column;
+        };
+        myStack<brace, 64> braceStack;
+        // To record current position
+        size_t offset = 0, line = 1, column = 1;
+        char c;
+        while (input.get(c)){
+            if ( c == '(' || c == '[' || c == '{' ){
+                braceStack.push(brace{c, offset, line, column});
+            } else if ( c == ')' || c == ']' || c == '}' ){
+                if (braceStack.empty() || !braceMatch(braceStack.top().c, c)){
+                    result = braceCheckResult{false, false, offset, line, column};
+                    break;
+                }
+                braceStack.pop();
             }
-            else braceStack.pop();
-        } else {
             // Update line and column
-            if ( c == '\n' ) {
+            if ( c == '\n' ){
                 ++line;
-                column = 0;
-            } else if ( c == '(' || c == '[' || c == '{' )
-                braceStack.push(c);
-            ++column;
-        }        
+                column = 1;
+            } else
+                ++column;
+            ++offset;
+        }
+        if (result.balanced && !braceStack.empty()){
+            brace b = braceStack.top();
+            result = braceCheckResult{false, true, b.offset, b.line, b.column};
+        }
+    } else if (mode == "Parallel"){
+# ifdef __linux__
+        int fd = open(fileName.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0){
+            cerr << "Error: cannot open " << fileName << "." << endl;
+            if (fd >= 0) close(fd);
+            return;
+        }
+        size_t size = st.st_size;
+        if (size > 0){
+            void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED){
+                cerr << "Error: cannot map " << fileName << "." << endl;
+                close(fd);
+                return;
+            }
+            madvise(data, size, MADV_SEQUENTIAL);
+            result = braceCheckParallel(static_cast<const char *>(data), size, pool);
+            munmap(data, size);
+        }
+        close(fd);
+# else
+        std::ifstream input(fileName, std::ios::binary);
+        if (!input){
+            cerr << "Error: cannot open " << fileName << "." << endl;
+            return;
+        }
+        string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        result = braceCheckParallel(data.data(), data.size(), pool);
+# endif
+    } else {
+        cerr << "Error: unknown brace checker mode " << mode << "." << endl;
+        return;
     }
     // Print the result
-    if ( error ){
-        cout << "Cannot find matching brace at:" << endl;
-        cout << "Line: " << line << ",   Column: " << column << endl;
+    if ( !result.balanced ){
+        cout << (result.unclosed ? "Unclosed brace at:" : "Cannot find matching brace at:") << endl;
+        cout << "Line: " << result.line << ",   Column: " << result.column << endl;
         return;
     } else 
         cout << "Perfect!" << endl;
 }
 
 //
-//  Postfix calculator:
-//  Calculate an expression in postfix notation(reverse Polish notation).
+//  Pop two operands, apply op and push the result. Return false on error.
+//  Shared by myPostfixCalculator and myCalculator.
 //
-double myPostfixCalculator(const string &postfix) {
-    std::stack<double> s;
-    string operand;
-    for (auto c : postfix){
-        // Push operands into stack
-        if ( !operand.empty() && ( c == '+' || c == '-' || c == '*' || c == '/' || c == ' ' ) ){
-            s.push(std::stod(operand));
-            operand.clear();
-        }
-        // Calculation
-        if ( c == '+' ){
-            double b = s.top(); s.pop();
-            double a = s.top(); s.pop();
-            s.push(a+b);
-        } else if ( c == '-' ){
-            double b = s.top(); s.pop();
-            double a = s.top(); s.pop();
-            s.push(a-b);
-        } else if ( c == '*' ){
-            double b = s.top(); s.pop();
-            double a = s.top(); s.pop();
-            s.push(a*b);
-        } else if ( c == '/' ){
-            double b = s.top(); s.pop();
+bool calculatorApply(myStack<double, 32> &s, char op) {
+    if (s.size() < 2){
+        cerr << "Error: missing operand of " << op << "." << endl;
+        return false;
+    }
+    double b = s.top(); s.pop();
+    double a = s.top(); s.pop();
+    switch (op){
+        case '+': s.push(a+b); break;
+        case '-': s.push(a-b); break;
+        case '*': s.push(a*b); break;
+        case '/':
             if ( b == 0 ) {
                 cerr << "Denominator cannot be 0!" << endl;
-                return 0;
+                return false;
             }
-            double a = s.top(); s.pop();
             s.push(a/b);
-        } else if ( c != ' ' ) {
-            // Complete operands
-            operand.push_back(c);
+            break;
+    }
+    return true;
+}
+
+//
+//  Postfix calculator:
+//  Calculate an expression in postfix notation(reverse Polish notation).
+//  Tokens are read in place by exprTokenizer, no allocation for common expressions.
+//
+double myPostfixCalculator(std::string_view postfix) {
+    myStack<double, 32> s;
+    exprTokenizer tokens(postfix);
+    for (exprToken token = tokens.next(); token.type != exprToken::END; token = tokens.next()){
+        if (token.type == exprToken::NUMBER){
+            s.push(token.value);
+        } else if (token.type == exprToken::OPERATOR){
+            if (!calculatorApply(s, token.op)) return 0;
+        } else {
+            cerr << "Error: invalid token " << token.text << "." << endl;
+            return 0;
         }
     }
+    if (s.size() != 1){
+        cerr << "Error: Invalid postfix expression." << endl;
+        return 0;
+    }
     return s.top();
 }
 
 //
 //  Infix calculator
-//  Convert an infix expression into postfix expression, then use myPostCalculator to calculate the value.
+//  Evaluate an infix expression directly with shunting-yard, without building the postfix text:
+//  an operator is applied to the operand stack when it would be appended to the postfix output.
+//
+double myCalculator(std::string_view infix) {
+    myStack<double, 32> values;
+    myStack<char, 32> ops;
+    exprTokenizer tokens(infix);
+    exprToken::kind previous = exprToken::LEFT;
+    for (exprToken token = tokens.next(); token.type != exprToken::END; token = tokens.next()){
+        switch (token.type){
+            case exprToken::NUMBER:
+                if (previous != exprToken::LEFT && previous != exprToken::OPERATOR){
+                    cerr << "Error: missing operator before " << token.text << "." << endl;
+                    return 0;
+                }
+                values.push(token.value);
+                break;
+            case exprToken::NAME:
+                cerr << "Error: unknown variable " << token.text << ", use myBatchCalculator for variables." << endl;
+                return 0;
+            case exprToken::LEFT:
+                if (previous != exprToken::LEFT && previous != exprToken::OPERATOR){
+                    cerr << "Error: missing operator before (." << endl;
+                    return 0;
+                }
+                ops.push('(');
+                break;
+            case exprToken::RIGHT:
+                while ( !ops.empty() && ops.top() != '(' ){
+                    if (!calculatorApply(values, ops.top())) return 0;
+                    ops.pop();
+                }
+                if (ops.empty()){
+                    cerr << "Error: unmatched ')'." << endl;
+                    return 0;
+                }
+                ops.pop();
+                break;
+            case exprToken::OPERATOR:
+                // Sign at the beginning or after '('
+                if (previous == exprToken::LEFT && (token.op == '+' || token.op == '-')){
+                    values.push(0);
+                } else if (previous == exprToken::LEFT || previous == exprToken::OPERATOR){
+                    cerr << "Error: missing operand before " << token.op << "." << endl;
+                    return 0;
+                }
+                while ( !ops.empty() && ops.top() != '(' && exprTokenizer::priority(ops.top()) >= exprTokenizer::priority(token.op) ){
+                    if (!calculatorApply(values, ops.top())) return 0;
+                    ops.pop();
+                }
+                ops.push(token.op);
+                break;
+            default:
+                cerr << "Error: invalid token " << token.text << "." << endl;
+                return 0;
+        }
+        previous = token.type;
+    }
+    while ( !ops.empty() ){
+        if (ops.top() == '('){
+            cerr << "Error: unmatched '('." << endl;
+            return 0;
+        }
+        if (!calculatorApply(values, ops.top())) return 0;
+        ops.pop();
+    }
+    if (values.size() != 1){
+        cerr << "Error: Invalid infix expression." << endl;
+        return 0;
+    }
+    return values.top();
+}
+
 //
-double myCalculator(const string &infix) {
-    return myPostfixCalculator(infix2Postfix(infix));
+//  Batch calculator
+//  Compile an infix expression once, then evaluate it over whole columns.
+//  columns maps every variable name of the expression to its column, the columns used by the expression have
+//  the same number of rows. Other columns are ignored, an expression without variables gives one row.
+//
+vector<double> myBatchCalculator(const string &infix, const std::map<string, vector<double>> &columns) {
+    myExpressionTree tree;
+    tree.readInfix(infix);
+    myExpressionProgram program = tree.compile();
+    size_t rows = 1;
+    vector<const double *> ordered;
+    for (auto &name : program.variables()){
+        auto it = columns.find(name);
+        if (it == columns.end()){
+            cerr << "Error: no column for variable " << name << "." << endl;
+            return {};
+        }
+        if (ordered.empty()) rows = it->second.size();
+        if (it->second.size() != rows){
+            cerr << "Error: columns should have the same number of rows." << endl;
+            return {};
+        }
+        ordered.push_back(it->second.data());
+    }
+    vector<double> out(rows);
+    program.evaluateBatch(ordered.data(), out.data(), rows);
+    return out;
 }
 
 